@@ -0,0 +1,453 @@
+//
+// Graphics Framework.
+// Copyright (C) 2011 Department of Computer Science, University of Copenhagen
+//
+
+
+/*******************************************************************\
+*                                                                   *
+*                        B e n c h m a r k s                        *
+*                                                                   *
+\*******************************************************************/
+
+// Micro-benchmarks of the building blocks of the render pipeline, and
+// macro-benchmarks which render the scenes of main.cpp without a window.
+//
+// The scenes read their data files relative to the current directory, so
+// run the program from the top of the source tree, e.g.
+//
+//     ./build/bench --benchmark_filter=Scene
+//
+// main.cpp is included, such that the scenes are drawn by exactly the same
+// code as in the interactive program; GRAPHICS_BENCHMARK leaves out its main().
+
+#define GRAPHICS_HEADLESS
+#define GRAPHICS_BENCHMARK
+#include "main.cpp"
+
+#include <chrono>
+#include <streambuf>
+#include <benchmark/benchmark.h>
+
+
+/*******************************************************************\
+*                                                                   *
+*                        Q u i e t S c o p e                        *
+*                                                                   *
+\*******************************************************************/
+
+// The scenes report degenerate triangles and the like on std::cout. The
+// messages are thrown away while a scene is timed, both because they are
+// slow and because std::cout is where the benchmark results go.
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) { return c; }
+};
+
+class QuietScope
+{
+public:
+    QuietScope() : m_old(std::cout.rdbuf(&m_null))
+    {}
+
+    ~QuietScope()
+    {
+	std::cout.rdbuf(this->m_old);
+    }
+
+private:
+    NullBuffer      m_null;
+    std::streambuf* m_old;
+};
+
+
+/*******************************************************************\
+*                                                                   *
+*                  M i c r o - B e n c h m a r k s                  *
+*                                                                   *
+\*******************************************************************/
+
+typedef MyMathTypes::real_type      real_type;
+typedef MyMathTypes::vector3_type   vector3_type;
+typedef MyMathTypes::matrix4x4_type matrix4x4_type;
+
+static void BM_LinearInterpolatorReal(benchmark::State& state)
+{
+    LinearInterpolator<MyMathTypes, real_type> interpolator;
+    int const length = 1024;
+    for (auto _ : state) {
+	interpolator.init(0, length - 1, real_type(-1.0), real_type(0.0));
+	while (interpolator.more_values()) {
+	    benchmark::DoNotOptimize(interpolator.value());
+	    interpolator.next_value();
+	}
+    }
+    state.SetItemsProcessed(state.iterations() * length);
+}
+BENCHMARK(BM_LinearInterpolatorReal);
+
+static void BM_LinearInterpolatorVector3(benchmark::State& state)
+{
+    LinearInterpolator<MyMathTypes, vector3_type> interpolator;
+    int const length = 1024;
+    for (auto _ : state) {
+	interpolator.init(0, length - 1, vector3_type(0.0, 0.5, 1.0), vector3_type(1.0, 0.5, 0.0));
+	while (interpolator.more_values()) {
+	    benchmark::DoNotOptimize(interpolator.value());
+	    interpolator.next_value();
+	}
+    }
+    state.SetItemsProcessed(state.iterations() * length);
+}
+BENCHMARK(BM_LinearInterpolatorVector3);
+
+static void BM_EdgeRasterizerWalk(benchmark::State& state)
+{
+    MyEdgeRasterizer<MyMathTypes> edge;
+    vector3_type normal(0.0, 0.0, 1.0);
+    vector3_type color(1.0, 0.0, 0.0);
+    long long steps = 0;
+    for (auto _ : state) {
+	edge.init(vector3_type(100.0,   0.0, -0.5), normal, vector3_type(0.0, 0.0, 0.0), color,
+		  vector3_type(  0.0, 400.0, -0.2), normal, vector3_type(1.0, 0.0, 0.0), color,
+		  vector3_type(200.0, 800.0, -0.9), normal, vector3_type(0.0, 1.0, 0.0), color);
+	while (edge.more_fragments()) {
+	    benchmark::DoNotOptimize(edge.x());
+	    edge.next_fragment();
+	    ++steps;
+	}
+    }
+    state.SetItemsProcessed(steps);
+}
+BENCHMARK(BM_EdgeRasterizerWalk);
+
+static matrix4x4_type BenchmarkMatrix()
+{
+    matrix4x4_type A;
+    for (int i = 1; i <= 4; ++i) {
+	for (int j = 1; j <= 4; ++j) {
+	    A[i][j] = (i == j) ? 4.0 : 1.0 / (i + j);
+	}
+    }
+    return A;
+}
+
+static void BM_MatrixMultiply(benchmark::State& state)
+{
+    matrix4x4_type A = BenchmarkMatrix();
+    matrix4x4_type B = A.T();
+    for (auto _ : state) {
+	matrix4x4_type C = A * B;
+	benchmark::DoNotOptimize(C);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatrixMultiply);
+
+static void BM_MatrixVectorMultiply(benchmark::State& state)
+{
+    matrix4x4_type A = BenchmarkMatrix();
+    MyMathTypes::vector4_type x(1.0, 2.0, 3.0, 1.0);
+    for (auto _ : state) {
+	benchmark::DoNotOptimize(x);
+	MyMathTypes::vector4_type y = A * x;
+	benchmark::DoNotOptimize(y);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatrixVectorMultiply);
+
+static void BM_TransformPoints(benchmark::State& state)
+{
+    matrix4x4_type A = BenchmarkMatrix();
+    std::vector<vector3_type>              points(state.range(0));
+    std::vector<MyMathTypes::vector4_type> result(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+	points[i] = vector3_type(real_type(i), real_type(i % 7), real_type(i % 13));
+    for (auto _ : state) {
+	TransformPoints(A, &points[0], &result[0], static_cast<unsigned int>(points.size()));
+	benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_TransformPoints)->Arg(4096);
+
+static void BM_MatrixInverse(benchmark::State& state)
+{
+    matrix4x4_type A = BenchmarkMatrix();
+    for (auto _ : state) {
+	matrix4x4_type C = Inverse(A);
+	benchmark::DoNotOptimize(C);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatrixInverse);
+
+static void BM_MatrixCofactorInverse(benchmark::State& state)
+{
+    matrix4x4_type A = BenchmarkMatrix();
+    for (auto _ : state) {
+	benchmark::DoNotOptimize(A);
+	matrix4x4_type C = CofactorInverse(A);
+	benchmark::DoNotOptimize(C);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatrixCofactorInverse);
+
+static void BM_MatrixAffineInverse(benchmark::State& state)
+{
+    matrix4x4_type A = BenchmarkMatrix();
+    A[4][1] = A[4][2] = A[4][3] = 0.0;
+    A[4][4] = 1.0;
+    for (auto _ : state) {
+	benchmark::DoNotOptimize(A);
+	matrix4x4_type C = AffineInverse(A);
+	benchmark::DoNotOptimize(C);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatrixAffineInverse);
+
+static void SetupPhongState(GraphicsState<MyMathTypes>& graphics_state)
+{
+    graphics_state.I_a()                = vector3_type(0.5, 0.5, 0.5);
+    graphics_state.I_p()                = vector3_type(1.0, 1.0, 1.0);
+    graphics_state.light_position()     = vector3_type(266.0, 274.0, -43.0);
+    graphics_state.eye_position()       = vector3_type(0.0, 0.0, 125.0);
+    graphics_state.z_eye_axis()         = vector3_type(0.0, 0.0, 1.0);
+    graphics_state.ambient_intensity()  = 0.5;
+    graphics_state.ambient_color()      = vector3_type(0.0, 1.0, 0.0);
+    graphics_state.diffuse_intensity()  = 0.75;
+    graphics_state.diffuse_color()      = vector3_type(0.0, 1.0, 0.0);
+    graphics_state.specular_intensity() = 0.9;
+    graphics_state.specular_color()     = vector3_type(1.0, 1.0, 1.0);
+    graphics_state.fall_off()           = 20.0;
+}
+
+static void BM_PhongFragment(benchmark::State& state)
+{
+    GraphicsState<MyMathTypes>         graphics_state;
+    MyPhongFragmentProgram<MyMathTypes> program;
+    SetupPhongState(graphics_state);
+
+    vector3_type position(10.0, 20.0, -5.0);
+    vector3_type normal(0.3, 0.2, 0.9);
+    vector3_type color(0.0, 1.0, 0.0);
+    vector3_type out_color;
+    for (auto _ : state) {
+	program.run(graphics_state, position, normal, color, out_color);
+	benchmark::DoNotOptimize(out_color);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PhongFragment);
+
+static void BM_PhongFragmentBatch(benchmark::State& state)
+{
+    typedef FragmentProgram<MyMathTypes>::fragment_batch_type fragment_batch_type;
+
+    GraphicsState<MyMathTypes>         graphics_state;
+    MyPhongFragmentProgram<MyMathTypes> program;
+    SetupPhongState(graphics_state);
+
+    fragment_batch_type batch = fragment_batch_type();
+    batch.count = FragmentProgram<MyMathTypes>::batch_size;
+    for (int j = 0; j < batch.count; ++j) {
+	batch.position[0][j] = 10.0 + j; batch.position[1][j] = 20.0; batch.position[2][j] = -5.0;
+	batch.normal[0][j]   = 0.3;      batch.normal[1][j]   = 0.2;  batch.normal[2][j]   = 0.9;
+	batch.color[0][j]    = 0.0;      batch.color[1][j]    = 1.0;  batch.color[2][j]    = 0.0;
+    }
+    for (auto _ : state) {
+	program.run_batch(graphics_state, batch);
+	benchmark::DoNotOptimize(batch.out_color);
+    }
+    state.SetItemsProcessed(state.iterations() * batch.count);
+}
+BENCHMARK(BM_PhongFragmentBatch);
+
+static void BM_TransformVertex(benchmark::State& state)
+{
+    GraphicsState<MyMathTypes>            graphics_state;
+    MyTransformVertexProgram<MyMathTypes> program;
+    SetupPhongState(graphics_state);
+    graphics_state.set_model(Z_Rotate(0.5), Inv_Z_Rotate(0.5));
+    graphics_state.set_projection(BenchmarkMatrix());
+
+    vector3_type position(10.0, 20.0, -5.0);
+    vector3_type normal(0.3, 0.2, 0.9);
+    vector3_type color(0.0, 1.0, 0.0);
+    MyMathTypes::vector4_type out_position;
+    vector3_type out_normal;
+    vector3_type out_color;
+    program.begin_batch(graphics_state, graphics_state.model_projection(), graphics_state.normal_matrix());
+    for (auto _ : state) {
+	program.run_homogeneous(graphics_state, position, normal, color, out_position, out_normal, out_color);
+	benchmark::DoNotOptimize(out_position);
+	benchmark::DoNotOptimize(out_color);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TransformVertex);
+
+// The argument is the pixel format of the frame buffer
+static void BM_FrameBufferClear(benchmark::State& state)
+{
+    FrameBuffer<MyMathTypes> frame_buffer;
+    frame_buffer.set_resolution(winWidth, winHeight);
+    frame_buffer.set_pixel_format(FrameBuffer<MyMathTypes>::pixel_format_type(state.range(0)));
+    for (auto _ : state) {
+	frame_buffer.clear(vector3_type(0.2, 0.4, 0.6));
+	benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * winWidth * winHeight);
+}
+BENCHMARK(BM_FrameBufferClear)->Arg(FrameBuffer<MyMathTypes>::rgb_float)
+			      ->Arg(FrameBuffer<MyMathTypes>::rgba8)
+			      ->Arg(FrameBuffer<MyMathTypes>::rgb565);
+
+static void BM_FrameBufferWritePixel(benchmark::State& state)
+{
+    FrameBuffer<MyMathTypes> frame_buffer;
+    frame_buffer.set_resolution(winWidth, winHeight);
+    frame_buffer.set_pixel_format(FrameBuffer<MyMathTypes>::pixel_format_type(state.range(0)));
+    vector3_type color(0.2, 0.4, 0.6);
+    for (auto _ : state) {
+	for (int y = 0; y < winHeight; ++y) {
+	    for (int x = 0; x < winWidth; ++x)
+		frame_buffer.write_pixel_unchecked(x, y, color);
+	}
+	benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * winWidth * winHeight);
+}
+BENCHMARK(BM_FrameBufferWritePixel)->Arg(FrameBuffer<MyMathTypes>::rgb_float)
+				   ->Arg(FrameBuffer<MyMathTypes>::rgba8)
+				   ->Arg(FrameBuffer<MyMathTypes>::rgb565);
+
+static void BM_ReadBezierPatches(benchmark::State& state)
+{
+    char const* filename = "./src/data/teapot.data";
+    std::vector<MyMathTypes::bezier_patch> patches;
+    for (auto _ : state) {
+	patches.clear();
+	if (ReadBezierPatches(filename, patches) < 0) {
+	    state.SkipWithError("Cannot read ./src/data/teapot.data, run from the top of the source tree");
+	    break;
+	}
+	benchmark::DoNotOptimize(patches.data());
+    }
+    state.SetItemsProcessed(state.iterations() * patches.size());
+}
+BENCHMARK(BM_ReadBezierPatches);
+
+static void BM_LoadBezierPatches(benchmark::State& state)
+{
+    char const* filename = "./src/data/teapot.data";
+    BezierPatchSet patches;
+    for (auto _ : state) {
+	patches = LoadBezierPatches(filename);
+	if (!patches) {
+	    state.SkipWithError("Cannot read ./src/data/teapot.data, run from the top of the source tree");
+	    break;
+	}
+	benchmark::DoNotOptimize(patches.get());
+    }
+    state.SetItemsProcessed(state.iterations() * (patches ? patches->size() : 0));
+}
+BENCHMARK(BM_LoadBezierPatches);
+
+// Evaluates the Dini surface of the dini scene, which the SurfaceMeshCache
+// does once and the scene did in every frame before. The arguments are the
+// tessellation in the u-parameter, N = 50 in the scene, and the number of
+// threads, where 0 means one per hardware thread.
+static void BM_SurfaceMeshTessellate(benchmark::State& state)
+{
+    int N = static_cast<int>(state.range(0));
+    int M = N / 4;
+
+    SurfaceMesh<MyMathTypes>::grid_type grid;
+    grid.u_start = 0.0;
+    grid.delta_u = (6.0 * M_PI) / N;
+    grid.u_stop  = 6.0 * M_PI;
+    grid.v_start = 0.001;
+    grid.delta_v = 2.0 / M;
+    grid.v_stop  = 2.0;
+
+    SurfaceMesh<MyMathTypes> mesh;
+    for (auto _ : state) {
+	mesh.tessellate(DiniPatch(2.0, 0.4), grid, cwhite, static_cast<int>(state.range(1)));
+	benchmark::DoNotOptimize(mesh.vertices().data());
+    }
+    state.SetItemsProcessed(state.iterations() * mesh.vertices().size());
+}
+BENCHMARK(BM_SurfaceMeshTessellate)->Args({50, 1})->Args({1000, 1})->Args({1000, 0})->UseRealTime();
+
+
+/*******************************************************************\
+*                                                                   *
+*                  M a c r o - B e n c h m a r k s                  *
+*                                                                   *
+\*******************************************************************/
+
+// The tessellation of the Bezier patches, unless a scene asks for another
+static CurveModels const default_curve_model = cur_curve_model;
+
+// Renders a scene of main.cpp at the default window size. The scenes set
+// up their own cameras, so every frame is the same. The counters come from
+// the statistics of the render pipeline, which are reset by every frame.
+static void BM_Scene(benchmark::State& state, HeadlessScene const* scene)
+{
+    figure   = scene->key;
+    cur_curve_model = scene->curve_model ? static_cast<CurveModels>(scene->curve_model) : default_curve_model;
+    t        = tmax;
+    t_subdiv = t_subdiv_max;
+
+    render_pipeline.load_vertex_program( identity_vertex_program );
+    render_pipeline.load_fragment_program( identity_fragment_program );
+    render_pipeline.set_resolution( winWidth, winHeight );
+    render_pipeline.state().ambient_intensity() = 0.5;
+    camera.init( render_pipeline );
+
+    double             milliseconds = 0.0;
+    PipelineStatistics statistics;
+    {
+	QuietScope quiet;
+	for (auto _ : state) {
+	    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	    display();
+	    milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	    statistics += render_pipeline.statistics();
+	}
+    }
+
+    state.counters["triangles/s"] = benchmark::Counter(statistics.triangles_submitted, benchmark::Counter::kIsRate);
+    state.counters["fragments/s"] = benchmark::Counter(statistics.fragments_generated, benchmark::Counter::kIsRate);
+    state.counters["shaded/s"]    = benchmark::Counter(statistics.fragments_shaded,    benchmark::Counter::kIsRate);
+    state.counters["ms/frame"]    = milliseconds / state.iterations();
+}
+
+int main(int argc, char** argv)
+{
+    // The scenes which are made of triangles
+    char const* scenes[] = {
+	"hidden-surfaces", "klein", "klein-gouraud", "phong-surface", "teapot", "teapot-gouraud",
+	"teapot-adaptive", "rocket", "sailboat", "sailboat-adaptive", "icosahedron-subdivided", "dini"
+    };
+    for (unsigned int s = 0; s < sizeof(scenes) / sizeof(scenes[0]); ++s) {
+	for (unsigned int i = 0; i < sizeof(headless_scenes) / sizeof(headless_scenes[0]); ++i) {
+	    if (std::string(scenes[s]) == headless_scenes[i].name) {
+		benchmark::RegisterBenchmark(("BM_Scene/" + std::string(scenes[s])).c_str(),
+					     BM_Scene, &headless_scenes[i])
+		    ->Unit(benchmark::kMillisecond)->UseRealTime();
+	    }
+	}
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
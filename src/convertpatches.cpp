@@ -0,0 +1,79 @@
+//
+// Graphics Framework.
+// Copyright (C) 2011 Department of Computer Science, University of Copenhagen
+//
+
+
+/*******************************************************************\
+*                                                                   *
+*                   C o n v e r t   P a t c h e s                   *
+*                                                                   *
+\*******************************************************************/
+
+// Converts a .data file of Bezier patches into the binary format of
+// solution/binarypatches.h, e.g.
+//
+//     ./build/convertpatches src/data/teapot.data teapot.bpatch
+//
+// The control points shared by several patches are stored once.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "graphics/graphics.h"
+#include "solution/math_types.h"
+#include "solution/readbezierpatches.h"
+#include "solution/binarypatches.h"
+
+using namespace graphics;
+
+typedef MyMathTypes::bezier_patch bezier_patch;
+
+
+/*******************************************************************\
+*                                                                   *
+*                            m a i n ( )                            *
+*                                                                   *
+\*******************************************************************/
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+	std::cout << "Usage: " << argv[0] << " <.data file> <.bpatch file>" << std::endl;
+	return 1;
+    }
+
+    std::vector<bezier_patch> patches;
+    if (ReadBezierPatches(argv[1], patches) != 0)
+	return 1;
+
+    //--- Store every distinct control point once
+    std::map<std::vector<float>, uint32_t> index_of;
+    std::vector<float>                     vertices;
+    std::vector<uint32_t>                  indices;
+    for (std::size_t p = 0; p < patches.size(); ++p) {
+	for (int i = 1; i <= 4; ++i) {
+	    for (int j = 1; j <= 4; ++j) {
+		std::vector<float> key(3);
+		key[0] = patches[p][i][j][1];
+		key[1] = patches[p][i][j][2];
+		key[2] = patches[p][i][j][3];
+
+		std::map<std::vector<float>, uint32_t>::iterator found = index_of.find(key);
+		if (found == index_of.end()) {
+		    found = index_of.insert(std::make_pair(key, static_cast<uint32_t>(vertices.size() / 3))).first;
+		    vertices.insert(vertices.end(), key.begin(), key.end());
+		}
+		indices.push_back(found->second);
+	    }
+	}
+    }
+
+    if (WriteBinaryPatches(argv[2], vertices, indices) != 0)
+	return 1;
+
+    std::cout << patches.size() << " patches, " << vertices.size() / 3 << " control points" << std::endl;
+    return 0;
+}
@@ -22,8 +22,11 @@
 #include "graphics_rasterizer.h"
 #include "graphics_fragment_program.h"
 #include "graphics_zbuffer.h"
+#include "graphics_image_file.h"
 #include "graphics_framebuffer.h"
 #include "graphics_state.h"
+#include "graphics_tile_binner.h"
+#include "graphics_statistics.h"
 #include "graphics_render_pipeline.h"
 #include "graphics_camera.h"
 
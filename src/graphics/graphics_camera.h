@@ -63,16 +63,14 @@ namespace graphics
 	 */
 	void reset() {
 	    matrix4x4_type I = Identity();
-	    this->m_state->model()                = I;
-	    this->m_state->inv_model()            = I;
-	    this->m_state->view_orientation()     = I;
-	    this->m_state->inv_view_orientation() = I;
-	    this->m_state->view_projection()      = I;
-	    this->m_state->inv_view_projection()  = I;
-	    this->m_state->window_viewport()      = I;
-	    this->m_state->inv_window_viewport()  = I;
-	    this->m_state->projection()           = I;
-	    this->m_state->inv_projection()       = I;
+	    this->m_state->set_model(I, I);
+	    this->m_state->set_view_orientation(I, I);
+	    this->m_state->set_view_projection(I, I);
+	    this->m_state->set_window_viewport(I, I);
+	    this->m_state->set_projection(I, I);
+
+	    //--- The state is written through m_state, which the RenderPipeline does not see
+	    this->m_renderpipeline->invalidate_vertex_cache();
 	}
 
 
@@ -101,7 +99,8 @@ namespace graphics
 	    this->m_state->view_orientation() = this->compute_view_orientation_matrix(vrp, vpn, vup);
 
 	    // Compute and Set the eye position - new matrix
-	    vector3_type eye_position = Vector3D(this->m_state->inv_view_orientation() * HomVector(prp));
+	    GraphicsState<math_types> const& state = *this->m_state;
+	    vector3_type eye_position = Vector3D(state.inv_view_orientation() * HomVector(prp));
 	    //std::cout << "New matrix eye_position = [" << eye_position << "]" << std::endl;
 
 	    this->m_state->eye_position() = eye_position;
@@ -119,7 +118,9 @@ namespace graphics
 	    matrix4x4_type M;
 	    M = this->m_state->window_viewport() * this->m_state->view_projection() * this->m_state->view_orientation();
 
-	    this->m_state->projection() = M;
+	    // The inverse is computed by the GraphicsState when it is needed
+	    this->m_state->set_projection(M);
+	    this->m_renderpipeline->invalidate_vertex_cache();
 	}
 
 	/**
@@ -137,7 +138,8 @@ namespace graphics
 	 */
 	matrix4x4_type get_inv_projection() const
 	{
-	    return this->m_state->inv_projection();
+	    GraphicsState<math_types> const& state = *this->m_state;
+	    return state.inv_projection();
 	}
 
 	/**
@@ -155,7 +157,8 @@ namespace graphics
 	 */
 	matrix4x4_type get_inv_view_orientation() const
         {
-	    return this->m_state->inv_view_orientation();
+	    GraphicsState<math_types> const& state = *this->m_state;
+	    return state.inv_view_orientation();
 	}
 
 	/**
@@ -173,7 +176,8 @@ namespace graphics
 	 */
 	matrix4x4_type get_inv_view_projection() const
         {
-	    return this->m_state->inv_view_projection();
+	    GraphicsState<math_types> const& state = *this->m_state;
+	    return state.inv_view_projection();
 	}
 
 	/**
@@ -187,6 +191,7 @@ namespace graphics
 
 	void set_inv_window_viewport(matrix4x4_type M){
 		this->m_state->inv_window_viewport() = M;
+		this->m_renderpipeline->invalidate_vertex_cache();
 	}
 
 	/**
@@ -195,7 +200,8 @@ namespace graphics
 	 */
 	matrix4x4_type get_inv_window_viewport() const
         {
-	    return this->m_state->inv_window_viewport();
+	    GraphicsState<math_types> const& state = *this->m_state;
+	    return state.inv_window_viewport();
 	}
 
 	/**
@@ -206,6 +212,7 @@ namespace graphics
 	void set_model_view(matrix4x4_type const& M)
 	{
 	    this->m_state->model() = M;
+	    this->m_renderpipeline->invalidate_vertex_cache();
 	}
 
 	/**
@@ -216,6 +223,7 @@ namespace graphics
 	void set_inv_model_view(matrix4x4_type const& M)
 	{
 	    this->m_state->inv_model() = M;
+	    this->m_renderpipeline->invalidate_vertex_cache();
 	}
 
     protected:
@@ -19,9 +19,30 @@ namespace graphics
     typedef typename  math_types::real_type       real_type;
     typedef GraphicsState<math_types>             graphics_state_type;
 
+    /// The number of fragments in a batch.
+    enum { batch_size = 8 };
+
+    /**
+     * A batch of fragments in structure-of-arrays layout, the i'th coordinate
+     * of fragment j is stored in position[i][j], and so on. The arrays are
+     * aligned, such that four or eight fragments can be loaded at once.
+     */
+    struct fragment_batch_type
+    {
+      alignas(32) real_type position[3][batch_size];
+      alignas(32) real_type normal[3][batch_size];
+      alignas(32) real_type color[3][batch_size];
+      alignas(32) real_type out_color[3][batch_size];
+
+      /// The number of fragments in use, the remaining entries are ignored.
+      int count;
+    };
+
   public:
 
-    virtual void run( 
+    virtual ~FragmentProgram(){}
+
+    virtual void run(
         graphics_state_type const & state
       , vector3_type const & in_position
       , vector3_type const & in_normal
@@ -29,6 +50,50 @@ namespace graphics
       , vector3_type & out_color
       ) = 0;
 
+    /**
+     * Test if the fragment program has its own implementation of run_batch.
+     * The render pipeline only collects fragments into batches if it has.
+     *
+     * @return true if run_batch is faster than running the fragments one at a time.
+     */
+    virtual bool batched() const
+    {
+      return false;
+    }
+
+    /**
+     * Run the fragment program on a batch of fragments.
+     * The default implementation runs the fragments one at a time.
+     *
+     * @param state  The graphics state.
+     * @param batch  The fragments, the computed colors are stored in batch.out_color.
+     */
+    virtual void run_batch(
+        graphics_state_type const & state
+      , fragment_batch_type & batch
+      )
+    {
+      vector3_type in_position;
+      vector3_type in_normal;
+      vector3_type in_color;
+      vector3_type out_color;
+
+      for (int j = 0; j < batch.count; ++j) {
+        for (int i = 0; i < 3; ++i) {
+          in_position[i + 1] = batch.position[i][j];
+          in_normal[i + 1]   = batch.normal[i][j];
+          in_color[i + 1]    = batch.color[i][j];
+        }
+        out_color = in_color;
+
+        this->run(state, in_position, in_normal, in_color, out_color);
+
+        for (int i = 0; i < 3; ++i) {
+          batch.out_color[i][j] = out_color[i + 1];
+        }
+      }
+    }
+
   };
 
 }// end namespace graphics
@@ -10,8 +10,14 @@
 #include <iomanip>
 #include <stdexcept>
 #include <cmath>
+#include <string>
 
 #include "graphics_state.h"
+#include "graphics_image_file.h"
+
+// With GRAPHICS_HEADLESS defined the FrameBuffer does not use OpenGL, such
+// that programs can render into it and save it without a display.
+#ifndef GRAPHICS_HEADLESS
 
 #ifdef WIN32
 #  define WIN32_LEAN_AND_MEAN
@@ -29,8 +35,13 @@
 #  include <GL/gl.h>
 #endif
 
+// GRAPHICS_HEADLESS
+#endif
+
 
 #include <vector>
+#include <cstring>
+#include <algorithm>
 
 namespace graphics
 {
@@ -42,6 +53,15 @@ namespace graphics
      * Each pixel consist of three color components: red, green, and blue.
      * Notice that the (0,0) entry of the array corresponds to the lower-left corner
      * on the ``screen'' (width-1,height-1) location corresponds to upper right corner.
+     *
+     * The pixels are stored in one of the formats of pixel_format_type. The colors
+     * are converted to the format when the pixels are written, and the packed formats
+     * are uploaded to OpenGL as they are. Only save() and read_pixel() convert back.
+     *
+     * Clearing is lazy. The pixels are divided into blocks of clear_block_size x
+     * clear_block_size, and clear() only marks every block as cleared. A cleared
+     * block is filled with the clear color just before its first pixel is written,
+     * and the blocks which are never drawn into are filled by flush() or save().
      */
     template< typename math_types >
     class FrameBuffer
@@ -56,11 +76,27 @@ namespace graphics
 	/// The actual type of a vector3.
 	typedef typename math_types::vector3_type vector3_type;
 
+	/// The formats in which the pixels can be stored.
+	enum pixel_format_type {
+	    rgb_float = 0,   ///< Three 32-bit floats, which are not clamped, e.g. for .exr files.
+	    rgba8,           ///< Four bytes, red, green, blue and an opaque alpha, packed in 32 bits.
+	    rgb565           ///< 5 bits of red, 6 of green and 5 of blue, packed in 16 bits.
+	};
+
+	/// The width and height of the blocks which are cleared lazily.
+	enum { clear_block_size = 8 };
+
     public:
 	/**
 	 * Creates a clean FrameBuffer.
 	 */
 	FrameBuffer()
+	    : m_format(rgb_float)
+	    , m_clear_rgba8(0)
+	    , m_clear_rgb565(0)
+	    , m_width(0)
+	    , m_height(0)
+	    , m_block_columns(0)
 	{}
 
 	/**
@@ -68,13 +104,13 @@ namespace graphics
 	 */
 	virtual ~FrameBuffer()
         {
-	    // The pixels are stored in a std::vector<real_type>, so there is nothing to clean up.
+	    // The pixels are stored in std::vectors, so there is nothing to clean up.
 	}
 
 	/**
 	 * Clear Framebuffer.
 	 * This method should be used to setup the background color before
-	 * doing any kind of drawing.
+	 * doing any kind of drawing. No pixels are written, see the class description.
 	 *
 	 * @param clear_color   The color to be used to clear the buffer. Each color component must be in the interval [0..1] otherwise an exception is thrown.
 	 *
@@ -88,14 +124,23 @@ namespace graphics
 	    if(clear_color[3] < 0 || clear_color[3] > 1)
 		throw std::invalid_argument("blue color must be within [0..1]");
 
-	    for(std::vector<float>::iterator c = m_pixels.begin(); c!= m_pixels.end();)
-	    {
-		*c = clear_color[1];
-		++c;
-		*c = clear_color[2];
-		++c;
-		*c = clear_color[3];
-		++c;
+	    this->m_clear_color  = clear_color;
+	    this->m_clear_rgba8  = pack_rgba8(clear_color);
+	    this->m_clear_rgb565 = pack_rgb565(clear_color);
+	    std::fill(this->m_cleared.begin(), this->m_cleared.end(), 1);
+	}
+
+	/**
+	 * Finish Clear.
+	 * Fills every block which is still cleared with the clear color, such
+	 * that all pixels are stored. Nothing is done for the blocks which have
+	 * been drawn into since the last clear.
+	 */
+	void finish_clear()
+	{
+	    for (int block = 0; block < static_cast<int>(this->m_cleared.size()); ++block) {
+		if (this->m_cleared[block])
+		    this->fill_block(block);
 	    }
 	}
 	
@@ -112,9 +157,31 @@ namespace graphics
 	    if (height <= 1)
 		throw std::invalid_argument("height must be larger than 1");
 
-	    this->m_pixels.resize(width*height*3);
 	    this->m_width  = width;
 	    this->m_height = height;
+	    this->allocate();
+	}
+
+	/**
+	 * Set Pixel Format.
+	 * The pixels are reallocated in the new format, so the FrameBuffer must
+	 * be cleared before it is drawn into.
+	 *
+	 * @param format  The format in which the pixels are stored.
+	 */
+	void set_pixel_format(pixel_format_type format)
+	{
+	    this->m_format = format;
+	    this->allocate();
+	}
+
+	/**
+	 * The Pixel Format.
+	 * @return the format in which the pixels are stored.
+	 */
+	pixel_format_type pixel_format() const
+	{
+	    return this->m_format;
 	}
 
 	/**
@@ -149,22 +216,16 @@ namespace graphics
 
 	/**
 	 * Write Pixel.
+	 * Pixels outside the FrameBuffer are skipped.
 	 *
 	 * @param x       The current x location of the pixel.
 	 * @param y       The current y location of the pixel.
-	 * @param value   The color to be written. Each color component must be in the interval [0..1] otherwise an exception is thrown.
+	 * @param value   The color to be written. Each color component should be in the interval [0..1].
+	 *                If GRAPHICS_VALIDATE is defined an exception is thrown otherwise.
 	 *
 	 */
 	void write_pixel(int  x, int y, vector3_type const& value)
 	{
-	    //--- Test to see if we actually got a real color
-	    if(value[1] < 0 || value[1] > 1)
-		throw std::invalid_argument("red color must be within [0..1]");
-	    if(value[2] < 0 || value[2] > 1)
-		throw std::invalid_argument("green color must be within [0..1]");
-	    if(value[3] < 0 || value[3] > 1)
-		throw std::invalid_argument("blue color must be within [0..1]");
-	    
 	    //--- Simple minded clipping against framebuffer
 	    if(x < 0)
 		return;
@@ -175,13 +236,55 @@ namespace graphics
 	    if(y >= this->m_height)
 		return;
 
-	    //--- Determine memory location of the pixel that should be written
-	    int offset = (y * m_width + x) * 3;
+	    this->write_pixel_unchecked(x, y, value);
+	}
+
+	/**
+	 * Write Pixel without Tests.
+	 * This is the version used for fragments by the RenderPipeline, which
+	 * scissors them to the FrameBuffer before the z-test. Nothing is tested,
+	 * unless GRAPHICS_VALIDATE is defined, in which case an exception is thrown
+	 * if the pixel is outside the FrameBuffer or the color is outside [0..1].
+	 *
+	 * @param x       The x location of the pixel. Must be within [0..width-1].
+	 * @param y       The y location of the pixel. Must be within [0..height-1].
+	 * @param value   The color to be written.
+	 */
+	void write_pixel_unchecked(int x, int y, vector3_type const& value)
+	{
+#ifdef GRAPHICS_VALIDATE
+	    //--- Test to see if we actually got a real color
+	    if(value[1] < 0 || value[1] > 1)
+		throw std::invalid_argument("red color must be within [0..1]");
+	    if(value[2] < 0 || value[2] > 1)
+		throw std::invalid_argument("green color must be within [0..1]");
+	    if(value[3] < 0 || value[3] > 1)
+		throw std::invalid_argument("blue color must be within [0..1]");
+
+	    if((x < 0) || (y < 0) || (x >= this->m_width) || (y >= this->m_height))
+		throw std::out_of_range("FrameBuffer::write_pixel_unchecked(): pixel outside the frame buffer");
+#endif
+
+	    //--- A block which is still cleared is filled before it is drawn into
+	    int block = this->block_of(x, y);
+	    if (this->m_cleared[block])
+		this->fill_block(block);
 
 	    //--- Wtite the pixel to the frame buffer
-	    m_pixels[offset]   = value[1];
-	    m_pixels[offset+1] = value[2];
-	    m_pixels[offset+2] = value[3];
+	    int offset = y * this->m_width + x;
+	    switch (this->m_format) {
+	    case rgba8:
+		this->m_rgba8_pixels[offset] = pack_rgba8(value);
+		break;
+	    case rgb565:
+		this->m_rgb565_pixels[offset] = pack_rgb565(value);
+		break;
+	    default:
+		float* pixel = &this->m_pixels[offset * 3];
+		pixel[0] = value[1];
+		pixel[1] = value[2];
+		pixel[2] = value[3];
+	    }
 	}
 
 
@@ -205,12 +308,17 @@ namespace graphics
 		return value;
 
 	    //--- Determine memory location of the pixel that should be written
-	    int offset = (y * m_width + x) * 3;
+	    int offset = y * m_width + x;
 
 	    // Get the pixel from the frame buffer
-	    value[1] = m_pixels[offset];
-	    value[2] = m_pixels[offset+1]; 
-	    value[3] = m_pixels[offset+2];
+	    float color[3];
+	    if (this->m_cleared[this->block_of(x, y)])
+		this->unpack_clear(color);
+	    else
+		this->unpack(offset, color);
+	    value[1] = color[0];
+	    value[2] = color[1]; 
+	    value[3] = color[2];
 
 	    return value;
 	}
@@ -225,15 +333,219 @@ namespace graphics
 	 */
 	void flush() 
 	{
+	    this->finish_clear();
+
+#ifndef GRAPHICS_HEADLESS
 	    //--- Ask OpenGL to draw our pixel array into the the
 	    //--- real-thing, the frame buffer in the graphics hardware.
-	    glDrawPixels( m_width, m_height,  GL_RGB, GL_FLOAT, &(m_pixels[0]) );
+	    switch (this->m_format) {
+	    case rgba8:
+		glDrawPixels( m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, &(m_rgba8_pixels[0]) );
+		break;
+	    case rgb565:
+#ifdef GL_UNSIGNED_SHORT_5_6_5
+		//--- The rows are only aligned to 2 bytes
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 2 );
+		glDrawPixels( m_width, m_height, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, &(m_rgb565_pixels[0]) );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+#else
+		//--- OpenGL 1.1 headers, e.g. on Windows, do not know packed pixels
+		{
+		    std::vector<float> pixels;
+		    this->unpack_all(pixels);
+		    glDrawPixels( m_width, m_height, GL_RGB, GL_FLOAT, &(pixels[0]) );
+		}
+#endif
+		break;
+	    default:
+		glDrawPixels( m_width, m_height,  GL_RGB, GL_FLOAT, &(m_pixels[0]) );
+	    }
+#endif
+	}
+
+	/**
+	 * Save to an Image File.
+	 * The format is chosen from the extension of the filename, see ImageFile::write().
+	 * Unlike flush() this does not need OpenGL.
+	 *
+	 * @param filename  The name of the file, ending in .ppm, .png, or .exr.
+	 */
+	void save(std::string const& filename)
+	{
+	    this->finish_clear();
+
+	    if (this->m_format == rgb_float) {
+		ImageFile::write(filename, this->m_width, this->m_height, &(m_pixels[0]));
+	    }
+	    else {
+		std::vector<float> pixels;
+		this->unpack_all(pixels);
+		ImageFile::write(filename, this->m_width, this->m_height, &(pixels[0]));
+	    }
 	}
 
     protected:
-	std::vector<float> m_pixels;     ///< Pixel memory. Pixels are stored as 3-tuples of red, green and blue color. A row format is adopted.
-	int                m_width;      ///< The number of pixels in a row.
-	int                m_height;     ///< The number of pixels in a column.
+	/**
+	 * Allocate the pixels of the current format and resolution, and
+	 * release those of the other formats.
+	 */
+	void allocate()
+	{
+	    int count = this->m_width * this->m_height;
+	    std::vector<float>().swap(this->m_pixels);
+	    std::vector<unsigned int>().swap(this->m_rgba8_pixels);
+	    std::vector<unsigned short>().swap(this->m_rgb565_pixels);
+	    switch (this->m_format) {
+	    case rgba8:  this->m_rgba8_pixels.resize(count);  break;
+	    case rgb565: this->m_rgb565_pixels.resize(count); break;
+	    default:     this->m_pixels.resize(count * 3);
+	    }
+
+	    this->m_block_columns = (this->m_width + clear_block_size - 1) / clear_block_size;
+	    int block_rows        = (this->m_height + clear_block_size - 1) / clear_block_size;
+	    this->m_cleared.assign(this->m_block_columns * block_rows, 0);
+	}
+
+	/// The index of the block of a pixel, which must be inside the FrameBuffer.
+	int block_of(int x, int y) const
+	{
+	    //--- Unsigned, such that the divisions become shifts
+	    return static_cast<int>((static_cast<unsigned int>(y) / clear_block_size) * this->m_block_columns
+				    + static_cast<unsigned int>(x) / clear_block_size);
+	}
+
+	/**
+	 * Fill a cleared block with the clear color, and mark it as drawn into.
+	 */
+	void fill_block(int block)
+	{
+	    int x_min = (block % this->m_block_columns) * clear_block_size;
+	    int y_min = (block / this->m_block_columns) * clear_block_size;
+	    int x_max = std::min(x_min + clear_block_size, this->m_width);
+	    int y_max = std::min(y_min + clear_block_size, this->m_height);
+	    for (int y = y_min; y < y_max; ++y) {
+		int begin = y * this->m_width + x_min;
+		int end   = y * this->m_width + x_max;
+		switch (this->m_format) {
+		case rgba8:
+		    std::fill(&this->m_rgba8_pixels[begin], &this->m_rgba8_pixels[0] + end, this->m_clear_rgba8);
+		    break;
+		case rgb565:
+		    std::fill(&this->m_rgb565_pixels[begin], &this->m_rgb565_pixels[0] + end, this->m_clear_rgb565);
+		    break;
+		default:
+		    for (float* pixel = &this->m_pixels[begin * 3]; pixel != &this->m_pixels[0] + end * 3; pixel += 3) {
+			pixel[0] = this->m_clear_color[1];
+			pixel[1] = this->m_clear_color[2];
+			pixel[2] = this->m_clear_color[3];
+		    }
+		}
+	    }
+	    this->m_cleared[block] = 0;
+	}
+
+	/// Clamps a color component to [0..1] and quantizes it to the given maximum value.
+	static unsigned int quantize(real_type const& value, unsigned int maximum)
+	{
+	    if (!(value > 0)) return 0;
+	    if (value >= 1)   return maximum;
+	    return static_cast<unsigned int>(value * maximum + real_type(0.5));
+	}
+
+	/// Packs a color into the bytes red, green, blue, alpha, in that order in memory.
+	static unsigned int pack_rgba8(vector3_type const& value)
+	{
+	    unsigned char bytes[4] = {
+		static_cast<unsigned char>(quantize(value[1], 255)),
+		static_cast<unsigned char>(quantize(value[2], 255)),
+		static_cast<unsigned char>(quantize(value[3], 255)),
+		255
+	    };
+	    unsigned int packed;
+	    std::memcpy(&packed, bytes, sizeof(packed));
+	    return packed;
+	}
+
+	/// Packs a color like GL_UNSIGNED_SHORT_5_6_5, with red in the high bits.
+	static unsigned short pack_rgb565(vector3_type const& value)
+	{
+	    return static_cast<unsigned short>((quantize(value[1], 31) << 11)
+					       | (quantize(value[2], 63) << 5)
+					       | quantize(value[3], 31));
+	}
+
+	/// Converts a pixel of rgba8 back to red, green and blue floats.
+	static void unpack_rgba8(unsigned int packed, float* color)
+	{
+	    unsigned char bytes[4];
+	    std::memcpy(bytes, &packed, sizeof(bytes));
+	    color[0] = bytes[0] / 255.0f;
+	    color[1] = bytes[1] / 255.0f;
+	    color[2] = bytes[2] / 255.0f;
+	}
+
+	/// Converts a pixel of rgb565 back to red, green and blue floats.
+	static void unpack_rgb565(unsigned short packed, float* color)
+	{
+	    color[0] = ((packed >> 11) & 31) / 31.0f;
+	    color[1] = ((packed >> 5) & 63)  / 63.0f;
+	    color[2] = (packed & 31)         / 31.0f;
+	}
+
+	/// Converts the pixel at offset back to red, green and blue floats.
+	void unpack(int offset, float* color) const
+	{
+	    switch (this->m_format) {
+	    case rgba8:
+		unpack_rgba8(this->m_rgba8_pixels[offset], color);
+		break;
+	    case rgb565:
+		unpack_rgb565(this->m_rgb565_pixels[offset], color);
+		break;
+	    default:
+		color[0] = this->m_pixels[offset * 3];
+		color[1] = this->m_pixels[offset * 3 + 1];
+		color[2] = this->m_pixels[offset * 3 + 2];
+	    }
+	}
+
+	/// Converts the clear color, as it is stored, to red, green and blue floats.
+	void unpack_clear(float* color) const
+	{
+	    switch (this->m_format) {
+	    case rgba8:
+		unpack_rgba8(this->m_clear_rgba8, color);
+		break;
+	    case rgb565:
+		unpack_rgb565(this->m_clear_rgb565, color);
+		break;
+	    default:
+		color[0] = this->m_clear_color[1];
+		color[1] = this->m_clear_color[2];
+		color[2] = this->m_clear_color[3];
+	    }
+	}
+
+	/// Converts all pixels to red, green and blue floats, like those of rgb_float.
+	void unpack_all(std::vector<float>& pixels) const
+	{
+	    int count = this->m_width * this->m_height;
+	    pixels.resize(count * 3);
+	    for (int i = 0; i < count; ++i)
+		this->unpack(i, &pixels[i * 3]);
+	}
+
+	pixel_format_type           m_format;          ///< The format in which the pixels are stored.
+	vector3_type                m_clear_color;     ///< The color of the last clear.
+	unsigned int                m_clear_rgba8;     ///< The color of the last clear, packed as rgba8.
+	unsigned short              m_clear_rgb565;    ///< The color of the last clear, packed as rgb565.
+	std::vector<float>          m_pixels;          ///< Pixel memory of rgb_float. Pixels are stored as 3-tuples of red, green and blue color. A row format is adopted.
+	std::vector<unsigned int>   m_rgba8_pixels;    ///< Pixel memory of rgba8, one packed pixel per entry, in the same row format.
+	std::vector<unsigned short> m_rgb565_pixels;   ///< Pixel memory of rgb565, one packed pixel per entry, in the same row format.
+	int                         m_width;           ///< The number of pixels in a row.
+	int                         m_height;          ///< The number of pixels in a column.
+	int                         m_block_columns;   ///< The number of blocks in a row.
+	std::vector<char>           m_cleared;         ///< Non-zero for every block which is cleared but not yet filled.
 
 
     };
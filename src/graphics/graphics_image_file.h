@@ -0,0 +1,302 @@
+#ifndef GRAPHICS_IMAGE_FILE_H
+#define GRAPHICS_IMAGE_FILE_H
+//
+// Graphics Framework.
+// Copyright (C) 2011 Department of Computer Science, University of Copenhagen
+//
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace graphics
+{
+    /**
+     * Image File.
+     * Writes an RGB image stored as floats to a PPM, PNG, or OpenEXR file,
+     * such that the frame buffer can be saved without a window or an OpenGL
+     * context. The formats are written directly, without any external
+     * libraries: PNG files are not compressed, and OpenEXR files hold
+     * uncompressed 32-bit float channels.
+     *
+     * The whole file is built in memory and written with a single call.
+     */
+    class ImageFile
+    {
+    public:
+	/**
+	 * Write an Image.
+	 * The format is chosen from the extension of the filename, which must
+	 * be .ppm, .png, or .exr (in any case), otherwise an exception is thrown.
+	 *
+	 * @param filename  The name of the file to write.
+	 * @param width     The number of pixels in a row.
+	 * @param height    The number of pixels in a column.
+	 * @param pixels    The red, green and blue color of each pixel, row by row,
+	 *                  starting with the lower-left corner like the FrameBuffer.
+	 */
+	static void write(std::string const& filename, int width, int height, float const* pixels)
+	{
+	    std::string::size_type dot = filename.rfind('.');
+	    std::string extension = (dot == std::string::npos) ? std::string() : filename.substr(dot + 1);
+	    std::transform(extension.begin(), extension.end(), extension.begin(), lower);
+
+	    std::vector<unsigned char> data;
+	    if (extension == "ppm")
+		encode_ppm(width, height, pixels, data);
+	    else if (extension == "png")
+		encode_png(width, height, pixels, data);
+	    else if (extension == "exr")
+		encode_exr(width, height, pixels, data);
+	    else
+		throw std::invalid_argument("ImageFile::write(): unknown image format '" + filename
+					    + "', use .ppm, .png, or .exr");
+
+	    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+	    if (!file)
+		throw std::runtime_error("ImageFile::write(): cannot open '" + filename + "'");
+	    file.write(reinterpret_cast<char const*>(&data[0]), data.size());
+	    if (!file)
+		throw std::runtime_error("ImageFile::write(): cannot write '" + filename + "'");
+	}
+
+	/**
+	 * Encode a binary PPM (P6) image with 8 bits per channel.
+	 */
+	static void encode_ppm(int width, int height, float const* pixels, std::vector<unsigned char>& data)
+	{
+	    std::string header = "P6\n" + to_string(width) + " " + to_string(height) + "\n255\n";
+
+	    data.assign(header.begin(), header.end());
+	    data.reserve(header.size() + 3 * width * height);
+	    for (int y = height - 1; y >= 0; --y) {
+		float const* row = pixels + 3 * width * y;
+		for (int i = 0; i < 3 * width; ++i)
+		    data.push_back(to_byte(row[i]));
+	    }
+	}
+
+	/**
+	 * Encode a PNG image with 8 bits per channel. The image data is stored
+	 * in uncompressed deflate blocks, which every PNG reader understands.
+	 */
+	static void encode_png(int width, int height, float const* pixels, std::vector<unsigned char>& data)
+	{
+	    //--- The raw scanlines, top to bottom, each preceded by filter type 0
+	    std::vector<unsigned char> raw;
+	    raw.reserve((3 * width + 1) * height);
+	    for (int y = height - 1; y >= 0; --y) {
+		float const* row = pixels + 3 * width * y;
+		raw.push_back(0);
+		for (int i = 0; i < 3 * width; ++i)
+		    raw.push_back(to_byte(row[i]));
+	    }
+
+	    //--- A zlib stream of stored blocks of at most 65535 bytes
+	    std::vector<unsigned char> zlib;
+	    zlib.reserve(raw.size() + 5 * (raw.size() / 65535 + 1) + 6);
+	    zlib.push_back(0x78);
+	    zlib.push_back(0x01);
+	    std::size_t offset = 0;
+	    do {
+		std::size_t length = std::min<std::size_t>(raw.size() - offset, 65535);
+		bool        last   = (offset + length == raw.size());
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(length & 0xff);
+		zlib.push_back((length >> 8) & 0xff);
+		zlib.push_back(~length & 0xff);
+		zlib.push_back((~length >> 8) & 0xff);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+		offset += length;
+	    } while (offset < raw.size());
+	    put_uint32_big(zlib, adler32(raw));
+
+	    static unsigned char const signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	    data.assign(signature, signature + 8);
+
+	    std::vector<unsigned char> header;
+	    put_uint32_big(header, width);
+	    put_uint32_big(header, height);
+	    header.push_back(8);    // bit depth
+	    header.push_back(2);    // color type RGB
+	    header.push_back(0);    // compression
+	    header.push_back(0);    // filter
+	    header.push_back(0);    // no interlace
+
+	    put_png_chunk(data, "IHDR", header);
+	    put_png_chunk(data, "IDAT", zlib);
+	    put_png_chunk(data, "IEND", std::vector<unsigned char>());
+	}
+
+	/**
+	 * Encode a scanline OpenEXR image with uncompressed 32-bit float channels.
+	 * The colors are written as they are, without clamping or gamma.
+	 */
+	static void encode_exr(int width, int height, float const* pixels, std::vector<unsigned char>& data)
+	{
+	    data.clear();
+	    put_uint32_little(data, 20000630);    // magic number
+	    put_uint32_little(data, 2);           // version 2, single part scanline image
+
+	    //--- The channels must be sorted by name
+	    std::vector<unsigned char> channels;
+	    char const* names = "BGR";
+	    for (int c = 0; c < 3; ++c) {
+		channels.push_back(names[c]);
+		channels.push_back(0);
+		put_uint32_little(channels, 2);   // FLOAT
+		put_uint32_little(channels, 0);   // pLinear and reserved
+		put_uint32_little(channels, 1);   // xSampling
+		put_uint32_little(channels, 1);   // ySampling
+	    }
+	    channels.push_back(0);
+
+	    std::vector<unsigned char> window;
+	    put_uint32_little(window, 0);
+	    put_uint32_little(window, 0);
+	    put_uint32_little(window, width - 1);
+	    put_uint32_little(window, height - 1);
+
+	    std::vector<unsigned char> zero(1, 0);
+	    std::vector<unsigned char> one;
+	    put_float_little(one, 1.0f);
+	    std::vector<unsigned char> center(8, 0);
+
+	    put_exr_attribute(data, "channels",           "chlist",      channels);
+	    put_exr_attribute(data, "compression",        "compression", zero);
+	    put_exr_attribute(data, "dataWindow",         "box2i",       window);
+	    put_exr_attribute(data, "displayWindow",      "box2i",       window);
+	    put_exr_attribute(data, "lineOrder",          "lineOrder",   zero);
+	    put_exr_attribute(data, "pixelAspectRatio",   "float",       one);
+	    put_exr_attribute(data, "screenWindowCenter", "v2f",         center);
+	    put_exr_attribute(data, "screenWindowWidth",  "float",       one);
+	    data.push_back(0);
+
+	    //--- The offset table, followed by one chunk per scanline
+	    std::size_t line_size = 3 * 4 * width;
+	    std::size_t start     = data.size() + 8 * height;
+	    data.reserve(start + height * (8 + line_size));
+	    for (int y = 0; y < height; ++y) {
+		unsigned long long position = start + y * (8 + line_size);
+		put_uint32_little(data, static_cast<unsigned int>(position & 0xffffffffULL));
+		put_uint32_little(data, static_cast<unsigned int>(position >> 32));
+	    }
+	    for (int y = 0; y < height; ++y) {
+		float const* row = pixels + 3 * width * (height - 1 - y);
+		put_uint32_little(data, y);
+		put_uint32_little(data, static_cast<unsigned int>(line_size));
+		for (int c = 2; c >= 0; --c) {
+		    for (int x = 0; x < width; ++x)
+			put_float_little(data, row[3 * x + c]);
+		}
+	    }
+	}
+
+    protected:
+	static char lower(char c)
+	{
+	    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+	}
+
+	static std::string to_string(int value)
+	{
+	    std::string digits;
+	    do {
+		digits.insert(digits.begin(), static_cast<char>('0' + value % 10));
+		value /= 10;
+	    } while (value > 0);
+	    return digits;
+	}
+
+	/// Clamps a color component to [0..1] and quantizes it to 8 bits.
+	static unsigned char to_byte(float value)
+	{
+	    if (!(value > 0.0f)) return 0;
+	    if (value >= 1.0f)   return 255;
+	    return static_cast<unsigned char>(value * 255.0f + 0.5f);
+	}
+
+	static void put_uint32_big(std::vector<unsigned char>& data, unsigned int value)
+	{
+	    data.push_back((value >> 24) & 0xff);
+	    data.push_back((value >> 16) & 0xff);
+	    data.push_back((value >> 8)  & 0xff);
+	    data.push_back(value & 0xff);
+	}
+
+	static void put_uint32_little(std::vector<unsigned char>& data, unsigned int value)
+	{
+	    data.push_back(value & 0xff);
+	    data.push_back((value >> 8)  & 0xff);
+	    data.push_back((value >> 16) & 0xff);
+	    data.push_back((value >> 24) & 0xff);
+	}
+
+	static void put_float_little(std::vector<unsigned char>& data, float value)
+	{
+	    union { float f; unsigned int u; } bits;
+	    bits.f = value;
+	    put_uint32_little(data, bits.u);
+	}
+
+	static void put_png_chunk(std::vector<unsigned char>& data, char const* type,
+				  std::vector<unsigned char> const& contents)
+	{
+	    put_uint32_big(data, static_cast<unsigned int>(contents.size()));
+	    std::size_t start = data.size();
+	    data.insert(data.end(), type, type + 4);
+	    data.insert(data.end(), contents.begin(), contents.end());
+	    put_uint32_big(data, crc32(&data[start], data.size() - start));
+	}
+
+	static void put_exr_attribute(std::vector<unsigned char>& data, char const* name, char const* type,
+				      std::vector<unsigned char> const& value)
+	{
+	    std::string n(name);
+	    std::string t(type);
+	    data.insert(data.end(), n.begin(), n.end());
+	    data.push_back(0);
+	    data.insert(data.end(), t.begin(), t.end());
+	    data.push_back(0);
+	    put_uint32_little(data, static_cast<unsigned int>(value.size()));
+	    data.insert(data.end(), value.begin(), value.end());
+	}
+
+	static unsigned int crc32(unsigned char const* bytes, std::size_t length)
+	{
+	    static unsigned int table[256];
+	    static bool         table_ready = false;
+	    if (!table_ready) {
+		for (unsigned int n = 0; n < 256; ++n) {
+		    unsigned int c = n;
+		    for (int k = 0; k < 8; ++k)
+			c = (c & 1) ? 0xedb88320U ^ (c >> 1) : (c >> 1);
+		    table[n] = c;
+		}
+		table_ready = true;
+	    }
+
+	    unsigned int crc = 0xffffffffU;
+	    for (std::size_t i = 0; i < length; ++i)
+		crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+	    return crc ^ 0xffffffffU;
+	}
+
+	static unsigned int adler32(std::vector<unsigned char> const& bytes)
+	{
+	    unsigned int a = 1;
+	    unsigned int b = 0;
+	    for (std::size_t i = 0; i < bytes.size(); ++i) {
+		a = (a + bytes[i]) % 65521;
+		b = (b + a) % 65521;
+	    }
+	    return (b << 16) | a;
+	}
+    };
+
+}// end namespace graphics
+
+// GRAPHICS_IMAGE_FILE_H
+#endif
@@ -10,6 +10,47 @@
 namespace graphics
 {
 
+    /**
+     * An Occlusion Query.
+     * Tells if a block of fragments would be hidden by what has already been
+     * drawn. The ZBuffer implements it, and a rasterizer may use it to skip
+     * blocks of fragments which would fail the z-test anyway.
+     */
+    template<typename math_types>
+    class OcclusionQuery
+    {
+    public:
+	typedef typename math_types::real_type        real_type;
+
+    public:
+	virtual ~OcclusionQuery(){}
+
+	/**
+	 * The margin by which a depth range estimated from the vertices of a
+	 * triangle is widened before it is queried, since the interpolated
+	 * depths of the fragments may round past the depths of the vertices.
+	 */
+	static double depth_slack()
+	{
+	    return 1e-6;
+	}
+
+	/**
+	 * Hidden Query.
+	 *
+	 * @param x_min  The smallest x-coordinate of the rectangle.
+	 * @param y_min  The smallest y-coordinate of the rectangle.
+	 * @param x_max  The largest x-coordinate of the rectangle.
+	 * @param y_max  The largest y-coordinate of the rectangle.
+	 * @param z_min  A lower bound of the depths of the fragments.
+	 * @param z_max  An upper bound of the depths of the fragments.
+	 *
+	 * @return true if every fragment inside the rectangle would fail the z-test.
+	 */
+	virtual bool hidden(int x_min, int y_min, int x_max, int y_max,
+			    real_type const& z_min, real_type const& z_max) const = 0;
+    };
+
     /**
      * This class describes an interface class for implementing a rasterizer.
      * One needs to make an inherited class like:
@@ -31,9 +72,106 @@ namespace graphics
 	typedef typename math_types::vector3_type     vector3_type;
 	typedef typename math_types::real_type        real_type;
 
+	/// The largest number of fragments in a span.
+	enum { span_size = 64 };
+
+	/**
+	 * A span of fragments in structure-of-arrays layout, the i'th coordinate
+	 * of the normal of fragment j is stored in normal[i][j], and so on.
+	 */
+	struct fragment_span_type
+	{
+	    int       x[span_size];
+	    int       y[span_size];
+	    real_type depth[span_size];
+	    real_type position[3][span_size];
+	    real_type normal[3][span_size];
+	    real_type color[3][span_size];
+
+	    /// The number of fragments in the span.
+	    int count;
+	};
+
     public:
 	Rasterizer(){}
 
+	virtual ~Rasterizer(){}
+
+	/**
+	 * Clone the Rasterizer.
+	 * The render pipeline uses clones to rasterize several triangles at the
+	 * same time, one clone per worker thread, when it is running in binning mode.
+	 * A rasterizer which cannot be cloned returns 0, and the render pipeline
+	 * then falls back to rasterize everything on the calling thread.
+	 *
+	 * @return A new copy of the rasterizer allocated with new, or 0.
+	 */
+	virtual Rasterizer<math_types>* clone() const
+	{
+	    return 0;
+	}
+
+	/**
+	 * Set the Scissor Rectangle.
+	 * Tells the rasterizer that only fragments inside the rectangle will be used
+	 * by the render pipeline. The rectangle is set before the rasterizer is
+	 * initialized with a triangle, and the rasterizer may use it to skip the
+	 * fragments outside it. The bounds are inclusive.
+	 *
+	 * The default implementation ignores the rectangle; the render pipeline
+	 * discards fragments outside it anyway.
+	 *
+	 * @param x_min  The smallest x-coordinate of a fragment.
+	 * @param y_min  The smallest y-coordinate of a fragment.
+	 * @param x_max  The largest x-coordinate of a fragment.
+	 * @param y_max  The largest y-coordinate of a fragment.
+	 */
+	virtual void scissor(int x_min, int y_min, int x_max, int y_max)
+	{}
+
+	/**
+	 * Set the Occlusion Query.
+	 * Like the scissor rectangle it is set before the rasterizer is
+	 * initialized with a triangle. The rasterizer may ask it which blocks of
+	 * fragments are hidden, and skip those blocks. The query is only valid
+	 * until the fragments of the triangle have been fetched.
+	 *
+	 * The default implementation ignores the query.
+	 *
+	 * @param query  The occlusion query, or 0 if there is none.
+	 */
+	virtual void occlusion_query(OcclusionQuery<math_types> const* query)
+	{}
+
+	/**
+	 * Deferred Attributes Query.
+	 * A rasterizer which defers the attributes only stores the position and
+	 * the depth of the fragments in the spans returned by next_fragments().
+	 * The render pipeline then runs the z-test first, and asks
+	 * interpolate_attributes() for the normal, world point and color of
+	 * the fragments which pass it.
+	 *
+	 * @return true if the attributes are deferred, the default is false.
+	 */
+	virtual bool deferred_attributes() const
+	{
+	    return false;
+	}
+
+	/**
+	 * Interpolate the Attributes of a Span.
+	 * Computes the normal, world point and color of the fragments in a span
+	 * from their x- and y-coordinates. It is only called if
+	 * deferred_attributes() is true, and only with fragments of the triangle
+	 * which is being rasterized.
+	 *
+	 * The default implementation does nothing.
+	 *
+	 * @param span  The fragments, only the first span.count of them are interpolated.
+	 */
+	virtual void interpolate_attributes(fragment_span_type& span) const
+	{}
+
     public:
 	/**
 	 * Initialize the Point Rasterizer.
@@ -179,6 +317,45 @@ namespace graphics
 	 * This method will ask the rastersizer to rasterize the next fragment.
 	 */
 	virtual void next_fragment() = 0;
+
+	/**
+	 * Get the next Fragments.
+	 * Stores the current fragment and the ones following it in a span, and
+	 * advances the rasterizer past them. This replaces the calls of x(), y(),
+	 * depth(), position(), normal(), color(), and next_fragment() for every
+	 * fragment, so a rasterizer which overrides it avoids a virtual call and a
+	 * state check per value.
+	 *
+	 * The default implementation calls the methods above. If the rasterizer
+	 * defers the attributes, only x, y, and depth need to be stored.
+	 *
+	 * @param span  Receives up to span_size fragments, span.count is set to their number.
+	 * @return      The number of fragments in the span, 0 if there are no more fragments.
+	 */
+	virtual int next_fragments(fragment_span_type& span)
+	{
+	    span.count = 0;
+	    while ((span.count < span_size) && this->more_fragments()) {
+		int const j = span.count;
+
+		span.x[j]     = this->x();
+		span.y[j]     = this->y();
+		span.depth[j] = this->depth();
+
+		vector3_type const position = this->position();
+		vector3_type const& normal  = this->normal();
+		vector3_type const& color   = this->color();
+		for (int i = 0; i < 3; ++i) {
+		    span.position[i][j] = position[i + 1];
+		    span.normal[i][j]   = normal[i + 1];
+		    span.color[i][j]    = color[i + 1];
+		}
+
+		++span.count;
+		this->next_fragment();
+	    }
+	    return span.count;
+	}
     };
 
 }// end namespace graphics
@@ -10,6 +10,14 @@
 #include <iomanip>
 #include <stdexcept>
 #include <cmath>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <limits>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <cassert>
 
 #include "graphics_vertex_program.h"
 #include "graphics_rasterizer.h"
@@ -17,6 +25,8 @@
 #include "graphics_zbuffer.h"
 #include "graphics_framebuffer.h"
 #include "graphics_state.h"
+#include "graphics_tile_binner.h"
+#include "graphics_statistics.h"
 
 namespace graphics
 {
@@ -180,15 +190,30 @@ namespace graphics
 	/// The actual type of the Rasterizer.
 	typedef Rasterizer<math_types>               rasterizer_type;
 
+	/// A span of fragments produced by the rasterizer.
+	typedef typename rasterizer_type::fragment_span_type fragment_span_type;
+
 	/// The actual type of the FragmentProgram.
 	typedef FragmentProgram<math_types>          fragment_program_type;
 
+	/// A batch of fragments which are shaded at once.
+	typedef typename fragment_program_type::fragment_batch_type fragment_batch_type;
+
 	/// The actual type of the ZBuffer.
 	typedef ZBuffer<math_types>                  zbuffer_type;
 
 	/// The actual type of the FrameBuffer.
 	typedef FrameBuffer<math_types>              frame_buffer_type;
 
+	/// The formats in which the FrameBuffer can store its pixels.
+	typedef typename frame_buffer_type::pixel_format_type pixel_format_type;
+
+	/// The actual type of the TileBinner used in binning mode.
+	typedef TileBinner<math_types>               tile_binner_type;
+
+	/// The counters and timers of the work done during a frame.
+	typedef PipelineStatistics                   statistics_type;
+
 	
     public:
 	/**
@@ -199,7 +224,12 @@ namespace graphics
 			   m_vertex_program(0),
 			   m_rasterizer(0),
 			   m_fragment_program(0),
-			   m_unitlength(1)
+			   m_unitlength(1),
+			   m_binning(false),
+			   m_thread_count(1),
+			   m_vertex_cache_count(0),
+			   m_vertex_cache_next(0),
+			   m_vertex_cache_checked(false)
 	{
 	    this->m_frame_buffer.set_resolution(this->m_width, this->m_height);
 	    this->m_zbuffer.set_resolution(this->m_width, this->m_height);
@@ -215,7 +245,12 @@ namespace graphics
 						m_vertex_program(0),
 						m_fragment_program(0),
 						m_rasterizer(0), 
-						m_unitlength(1)
+						m_unitlength(1),
+						m_binning(false),
+						m_thread_count(1),
+						m_vertex_cache_count(0),
+						m_vertex_cache_next(0),
+						m_vertex_cache_checked(false)
 	{
 	    this->m_frame_buffer.set_resolution(this->m_width, this->m_height);
 	    this->m_zbuffer.set_resolution(this->m_width, this->m_height); 
@@ -241,6 +276,8 @@ namespace graphics
 	    this->m_height = height;
 	    this->m_frame_buffer.set_resolution(this->m_width, this->m_height);
 	    this->m_zbuffer.set_resolution(this->m_width, this->m_height);
+	    if (this->m_binning)
+		this->m_binner.set_resolution(this->m_width, this->m_height, this->m_binner.tile_size());
 	}
 	
 	/**
@@ -273,10 +310,33 @@ namespace graphics
 	    return this->m_frame_buffer.height();
 	}
 
+	/**
+	 * Set Pixel Format.
+	 * Selects the format of the pixels in the FrameBuffer, see FrameBuffer::pixel_format_type.
+	 * The FrameBuffer is reallocated, so it must be cleared before drawing.
+	 *
+	 * @param format  The new pixel format.
+	 */
+	void set_pixel_format(pixel_format_type format)
+	{
+	    this->resolve();
+	    this->m_frame_buffer.set_pixel_format(format);
+	}
+
+	/**
+	 * The Pixel Format.
+	 * @return the format of the pixels in the FrameBuffer.
+	 */
+	pixel_format_type pixel_format() const
+	{
+	    return this->m_frame_buffer.pixel_format();
+	}
+
 	/**
 	 * Clear Buffers.
 	 * This method should be used to setup the background color and z-values before
-	 * doing any kind of drawing.
+	 * doing any kind of drawing. It also resets the statistics, such that they
+	 * cover what is drawn until the next clear.
 	 *
 	 * @param color   The color to be used to clear the buffer. 
 	 *                Each color component must be in the interval [0..1] 
@@ -287,8 +347,34 @@ namespace graphics
 	 */
 	void clear(real_type const& depth, vector3_type const& color)
 	{
+	    //--- Triangles still waiting in the bins would be cleared anyway
+	    this->m_binner.reset();
+
 	    this->m_frame_buffer.clear(color);
 	    this->m_zbuffer.clear(depth);
+
+	    this->m_statistics.reset();
+	}
+
+	/**
+	 * The Statistics.
+	 * Pending triangles in the bins are not counted until they are resolved,
+	 * so call flush or resolve before reading the fragment counters.
+	 *
+	 * @return The work done by the RenderPipeline since it was last cleared.
+	 */
+	statistics_type const& statistics() const
+	{
+	    return this->m_statistics;
+	}
+
+	/**
+	 * Reset the Statistics.
+	 * Sets all counters and timers to zero without clearing the buffers.
+	 */
+	void reset_statistics()
+	{
+	    this->m_statistics.reset();
 	}
 
 	/**
@@ -303,11 +389,15 @@ namespace graphics
 
 	/**
 	 * The Graphics State.
+	 * The vertex cache is checked against the state again by the next
+	 * draw_triangle. A writable reference which is kept and written to
+	 * after that must be followed by invalidate_vertex_cache().
 	 *
 	 * @return A writable reference to the current state of the RenderPipeline.
 	 */
 	graphics_state_type& state()
 	{
+	    this->m_vertex_cache_checked = false;
 	    return this->m_state;
 	}
 
@@ -318,9 +408,25 @@ namespace graphics
 	 */
 	void load_vertex_program( vertex_program_type& program )
 	{
+	    //--- The vertices in the cache were shaded by the old program
+	    if (this->m_vertex_program != &program)
+		this->invalidate_vertex_cache();
 	    this->m_vertex_program = &program;
 	}
 
+	/**
+	 * Empty the Vertex Cache.
+	 * draw_triangle keeps the last vertices it has shaded, and takes them from
+	 * the cache if they are drawn again with the same vertex program and the
+	 * same GraphicsState. A vertex program whose output depends on anything
+	 * else must have the cache emptied whenever that changes.
+	 */
+	void invalidate_vertex_cache()
+	{
+	    this->m_vertex_cache_count = 0;
+	    this->m_vertex_cache_next  = 0;
+	}
+
 	/**
 	 * Load a Rasterizer.
 	 * @param rasterizer The Rasterizer to be loaded.
@@ -339,6 +445,136 @@ namespace graphics
 	    this->m_fragment_program = &program;
 	}
 
+	/**
+	 * Turn on Binning Mode.
+	 * In binning mode draw_triangle and draw_indexed_triangles only run the vertex
+	 * program. The resulting triangles are sorted into tiles of the screen, and are
+	 * rasterized when resolve is invoked, by a pool of worker threads which each
+	 * take one tile at a time. The tiles are made of whole blocks of the depth
+	 * pyramid and of the lazy clear, so no two tiles share a pixel or a block,
+	 * and the threads never touch the same part of the FrameBuffer or the ZBuffer.
+	 *
+	 * Each worker thread uses its own clone of the loaded rasterizer, so the
+	 * rasterizer must implement Rasterizer::clone, otherwise all tiles are
+	 * rasterized on the calling thread. The loaded fragment programs are shared
+	 * between the threads, and must therefore not modify any data of their own.
+	 *
+	 * Note: The fragment programs see the GraphicsState as it is when resolve is
+	 *       invoked, so light and material parameters must stay the same between
+	 *       drawing the triangles and resolving them. Binning is bypassed when the
+	 *       unit length is different from 1.
+	 *
+	 * @param tile_size     The width and height of a tile in pixels. Must be a positive
+	 *                      multiple of ZBuffer::pyramid_size and FrameBuffer::clear_block_size,
+	 *                      otherwise an exception is thrown.
+	 * @param thread_count  The number of worker threads. If it is 0 the number of
+	 *                      hardware threads is used.
+	 */
+	void enable_binning(int tile_size = 64, int thread_count = 0)
+	{
+	    if ((tile_size <= 0) || (tile_size % zbuffer_type::pyramid_size != 0) ||
+		(tile_size % frame_buffer_type::clear_block_size != 0))
+		throw std::invalid_argument("RenderPipeline::enable_binning(): the tile size is not a multiple of the block size");
+
+	    this->resolve();
+
+	    if (thread_count <= 0)
+		thread_count = static_cast<int>(std::thread::hardware_concurrency());
+	    if (thread_count <= 0)
+		thread_count = 1;
+
+	    this->m_binner.set_resolution(this->m_width, this->m_height, tile_size);
+	    this->m_thread_count = thread_count;
+	    this->m_binning = true;
+	}
+
+	/**
+	 * Turn off Binning Mode.
+	 * Any triangles waiting in the bins are rasterized before returning.
+	 */
+	void disable_binning()
+	{
+	    this->resolve();
+	    this->m_binning = false;
+	}
+
+	/**
+	 * Query Binning Mode.
+	 * @return true if the render pipeline is in binning mode, false otherwise.
+	 */
+	bool binning() const
+	{
+	    return this->m_binning;
+	}
+
+	/**
+	 * Resolve the Bins.
+	 * Rasterizes all triangles which are waiting in the bins. This is done
+	 * automatically by flush, and before any points or lines are drawn, such
+	 * that everything ends up in the order it was drawn.
+	 *
+	 * If a worker thread fails, an exception is thrown once all threads have finished.
+	 */
+	void resolve()
+	{
+	    if (this->m_binner.empty())
+		return;
+
+	    //--- The worker threads need a clone of every rasterizer in use
+	    bool cloneable = true;
+	    std::vector<rasterizer_type*> const& rasterizers = this->m_binner.rasterizers();
+	    for (int i = 0; i < static_cast<int>(rasterizers.size()); ++i) {
+		rasterizer_type* probe = rasterizers[i]->clone();
+		if (probe == 0) cloneable = false;
+		delete probe;
+	    }
+
+	    int thread_count = cloneable ? std::min(this->m_thread_count, this->m_binner.tile_count()) : 1;
+
+	    //--- While the workers run, each of them only touches the finest level of
+	    //--- the depth pyramid, and the cleared blocks, inside its own tiles. The
+	    //--- tiles are aligned with the blocks, see enable_binning.
+	    this->m_zbuffer.defer_pyramid(true);
+
+	    //--- Every worker counts into its own statistics, they are added up afterwards
+	    std::atomic<int>             next_tile(0);
+	    std::vector<std::string>     errors(thread_count);
+	    std::vector<statistics_type> statistics(thread_count);
+	    std::vector<std::thread>     workers;
+	    try {
+		for (int i = 1; i < thread_count; ++i) {
+		    workers.push_back(std::thread(&RenderPipeline::rasterize_tiles, this,
+						  std::ref(next_tile), true, std::ref(errors[i]),
+						  std::ref(statistics[i])));
+		}
+		//--- The calling thread does its share of the work as well
+		this->rasterize_tiles(next_tile, thread_count > 1, errors[0], statistics[0]);
+	    }
+	    catch (...) {
+		//--- A thread could not be started, so the running ones are stopped and joined
+		next_tile = this->m_binner.tile_count();
+		for (int i = 0; i < static_cast<int>(workers.size()); ++i)
+		    workers[i].join();
+		this->m_zbuffer.defer_pyramid(false);
+		this->m_binner.reset();
+		throw;
+	    }
+
+	    for (int i = 0; i < static_cast<int>(workers.size()); ++i)
+		workers[i].join();
+
+	    for (int i = 0; i < thread_count; ++i)
+		this->m_statistics += statistics[i];
+
+	    this->m_zbuffer.defer_pyramid(false);
+	    this->m_binner.reset();
+
+	    for (int i = 0; i < thread_count; ++i) {
+		if (!errors[i].empty())
+		    throw std::runtime_error("RenderPipeline::resolve(): " + errors[i]);
+	    }
+	}
+
 	
     protected:
 	/**
@@ -422,6 +658,8 @@ namespace graphics
 	*/
 	int unit_length(int new_unitlength)
 	{
+	    this->resolve();
+
 	    int old_unitlength = this->m_unitlength;
 	    this->m_unitlength = new_unitlength;
 	    return old_unitlength;
@@ -581,10 +819,36 @@ namespace graphics
 	}
 
 
+	/**
+	 * Scissor Rectangle.
+	 * The fragments which are shaded. With unit length 1 this is the screen,
+	 * such that fragments can be written to the frame buffer without tests.
+	 * Otherwise every fragment is drawn as a disk, which is clipped on its own.
+	 */
+	void scissor_rectangle(int& x_min, int& y_min, int& x_max, int& y_max) const
+	{
+	    if (this->m_unitlength == 1) {
+		x_min = 0;
+		y_min = 0;
+		x_max = this->m_frame_buffer.width()  - 1;
+		y_max = this->m_frame_buffer.height() - 1;
+	    }
+	    else {
+		x_min = std::numeric_limits<int>::min();
+		y_min = std::numeric_limits<int>::min();
+		x_max = std::numeric_limits<int>::max();
+		y_max = std::numeric_limits<int>::max();
+	    }
+	}
+
+	/**
+	 * Write a shaded fragment to the frame buffer. The fragment must be
+	 * inside the scissor rectangle.
+	 */
 	void write_pixel_to_frame_buffer(int x, int y, vector3_type const& color)
 	{
 	    if (this->m_unitlength == 1) {
-		this->m_frame_buffer.write_pixel(x, y, color);
+		this->m_frame_buffer.write_pixel_unchecked(x, y, color);
 	    }
 	    else {
 		this->draw_disk(x * this->m_unitlength, y * this->m_unitlength, 
@@ -659,52 +923,36 @@ namespace graphics
 
 	    if(this->m_fragment_program == 0)
 		throw std::logic_error("fragment program was not loaded");
+
+	    //--- The vertex program gets the transformations once per draw call
+	    this->begin_vertex_batch();
+
+	    //--- Binned triangles must be drawn before the point
+	    this->resolve();
 		
 	    //--- Temporaries used to hold output from vertex program
 	    vector3_type out_vertex1;
 	    vector3_type out_color1;
 	    
 	    //--- Ask vertex program to process all the vertex data.
-	    this->m_vertex_program->run(this->state(),
-					in_vertex1,  in_color1,
-					out_vertex1, out_color1);
+	    {
+		GRAPHICS_STAGE_TIMER(this->m_statistics, vertex_stage);
+		this->m_vertex_program->run(this->m_state,
+					    in_vertex1,  in_color1,
+					    out_vertex1, out_color1);
+		this->m_statistics.vertices_shaded += 1;
+	    }
 
 	    //--- Initialize rasterizer with output from the vertex program
-	    this->m_rasterizer->init(out_vertex1, out_color1);
-
-	    //--- Keep on processing fragments until there are none left
-	    while( this->m_rasterizer->more_fragments() ) {
-			//--- get screen location of the current fragment
-			int screen_x = this->m_rasterizer->x();
-			int screen_y = this->m_rasterizer->y();
-
-			//--- extract old and new z value and perform a z-test
-			real_type z_old = this->m_zbuffer.read( screen_x, screen_y );
-			real_type z_new = this->m_rasterizer->depth();
-
-			if( this->state().ztest( z_old, z_new ) )
-			{
-				//--- The fragment passed the z-test, now we need to ask
-				//--- the fragment program to compute the color of the fragment.
-				vector3_type out_color;               // uninitialized!
-				out_color = this->m_rasterizer->color();    // now initialized!
-
-				this->m_fragment_program->run(this->state(),
-							  m_rasterizer->position(),
-							  m_rasterizer->normal(),
-							  m_rasterizer->color(),
-							  out_color);
-
-				//--- Finally we write the new z-value to the z-buffer
-				//--- and the new color to the frame buffer.
-				this->m_zbuffer.write( screen_x, screen_y, z_new);
-				this->write_pixel_to_frame_buffer(screen_x, screen_y, out_color);
-			}
-
-			//--- We finished processing the fragment, so we
-			//--- can advance to the next fragment.
-			this->m_rasterizer->next_fragment();
+	    {
+		GRAPHICS_STAGE_TIMER(this->m_statistics, setup_stage);
+		this->m_rasterizer->init(out_vertex1, out_color1);
 	    }
+
+	    int x_min, y_min, x_max, y_max;
+	    this->scissor_rectangle(x_min, y_min, x_max, y_max);
+	    this->shade_fragments(*this->m_rasterizer, *this->m_fragment_program,
+				  x_min, y_min, x_max, y_max, this->m_statistics);
 	}
 
 
@@ -736,6 +984,12 @@ namespace graphics
 
 	  if(!(this->m_fragment_program))
 		throw std::logic_error("fragment program was not loaded");
+
+	    //--- The vertex program gets the transformations once per draw call
+	    this->begin_vertex_batch();
+
+	    //--- Binned triangles must be drawn before the line
+	    this->resolve();
 		
 	    //--- Temporaries used to hold output from vertex program
 	    vector3_type out_vertex1;
@@ -744,52 +998,29 @@ namespace graphics
 	    vector3_type out_color2;
 	    
 	    //--- Ask vertex program to process all the vertex data.
-	    m_vertex_program->run(this->state(),
-				  in_vertex1,  in_color1,
-				  out_vertex1, out_color1);
-
-	    m_vertex_program->run(this->state(),
-				  in_vertex2,  in_color2,
-				  out_vertex2, out_color2);
+	    {
+		GRAPHICS_STAGE_TIMER(this->m_statistics, vertex_stage);
+		m_vertex_program->run(this->m_state,
+				      in_vertex1,  in_color1,
+				      out_vertex1, out_color1);
+
+		m_vertex_program->run(this->m_state,
+				      in_vertex2,  in_color2,
+				      out_vertex2, out_color2);
+		this->m_statistics.vertices_shaded += 2;
+	    }
 
 	    //--- Initialize rasterizer with output from the vertex program
-	    m_rasterizer->init(out_vertex1, out_color1,
-			       out_vertex2, out_color2);
-		
-	    //--- Keep on processing fragments until there are none left
-	    while( this->m_rasterizer->more_fragments() )
 	    {
-		//--- get screen location of the current fragment
-		int screen_x = this->m_rasterizer->x();
-		int screen_y = this->m_rasterizer->y();
-		    
-		//--- extract old and new z value and perform a z-test
-		real_type z_old = this->m_zbuffer.read( screen_x, screen_y );
-		real_type z_new = this->m_rasterizer->depth();
-		
-		if( this->state().ztest( z_old, z_new ) )
-		{
-		    //--- The fragment passed the z-test, now we need to ask
-		    //--- the fragment program to compute the color of the fragment.
-		    vector3_type out_color;               // uninitialized!
-		    out_color = this->m_rasterizer->color();    // now initialized!
-
-		    this->m_fragment_program->run(this->state(),
-						  m_rasterizer->position(),
-						  m_rasterizer->normal(),
-						  m_rasterizer->color(),
-						  out_color);
-
-		    //--- Finally we write the new z-value to the z-buffer
-		    //--- and the new color to the frame buffer.
-		    this->m_zbuffer.write( screen_x, screen_y, z_new);
-		    this->write_pixel_to_frame_buffer(screen_x, screen_y, out_color);
-		}
-		    
-		//--- We finished processing the fragment, so we
-		//--- can advance to the next fragment.
-		this->m_rasterizer->next_fragment();
+		GRAPHICS_STAGE_TIMER(this->m_statistics, setup_stage);
+		m_rasterizer->init(out_vertex1, out_color1,
+				   out_vertex2, out_color2);
 	    }
+
+	    int x_min, y_min, x_max, y_max;
+	    this->scissor_rectangle(x_min, y_min, x_max, y_max);
+	    this->shade_fragments(*this->m_rasterizer, *this->m_fragment_program,
+				  x_min, y_min, x_max, y_max, this->m_statistics);
 	}
 
 
@@ -799,6 +1030,13 @@ namespace graphics
 	 * 3  normals, and 3 colors). Vertex data is basically turned into pixels in
 	 * the framebuffer.
 	 *
+	 * Like the post-transform cache of graphics hardware, the last vertices which
+	 * have been run through the vertex program are kept, and a corner which is
+	 * bitwise the same as one of them, e.g. because the triangles come from a
+	 * strip, is taken from the cache instead of being shaded again. The cache
+	 * is emptied when a different vertex program is loaded or the GraphicsState
+	 * changes, see invalidate_vertex_cache.
+	 *
 	 * Note: If renderpipeline is not correctly setup then an exception is thrown.
 	 *
 	 *
@@ -832,76 +1070,175 @@ namespace graphics
 	    if(!m_fragment_program)
 		throw std::logic_error("fragment program was not loaded");
 
-	    
-	    vector3_type Worldvertex1 = in_vertex1;
-	    vector3_type Worldvertex2 = in_vertex2;
-	    vector3_type Worldvertex3 = in_vertex3;
+	    //--- The vertex program gets the transformations once per draw call
+	    this->begin_vertex_batch();
 
+	    this->m_statistics.triangles_submitted += 1;
 
-	    //--- Temporaries used to hold output from vertex program
-	    vector3_type out_vertex1;
-	    vector3_type out_vertex2;
-	    vector3_type out_vertex3;
+	    //--- The triangle is clipped if the vertex program leaves out the division by w
+	    bool clipping = m_vertex_program->homogeneous() && this->m_state.clipping();
 
-	    vector3_type out_normal1;
-	    vector3_type out_normal2;
-	    vector3_type out_normal3;
+	    //--- Ask vertex program to process the corners which are not in the cache.
+	    //--- The corners are copied, since a corner found in the oldest entry is
+	    //--- replaced if the next one is not found.
+	    cached_vertex_type corner[3];
+	    {
+		GRAPHICS_STAGE_TIMER(this->m_statistics, vertex_stage);
+		//--- The state can only have changed if it has been handed out since the last check
+		if (!this->m_vertex_cache_checked) {
+		    if ((this->m_vertex_cache_count > 0) && !this->m_vertex_cache_state.same_settings(this->m_state))
+			this->invalidate_vertex_cache();
+		    this->m_vertex_cache_checked = true;
+		}
 
-	    vector3_type out_color1;
-	    vector3_type out_color2;
-	    vector3_type out_color3;
-	    
-	    //--- Ask vertex program to process all the vertex data.
-	    m_vertex_program->run(this->state(),
-				  in_vertex1,  in_normal1,  in_color1,
-				  out_vertex1, out_normal1, out_color1);
+		corner[0] = this->shade_cached_vertex(in_vertex1, in_normal1, in_color1, clipping);
+		corner[1] = this->shade_cached_vertex(in_vertex2, in_normal2, in_color2, clipping);
+		corner[2] = this->shade_cached_vertex(in_vertex3, in_normal3, in_color3, clipping);
+	    }
 
-	    m_vertex_program->run(this->state(),
-				  in_vertex2, in_normal2, in_color2,
-				  out_vertex2, out_normal2,  out_color2);
+	    if (clipping) {
+		clip_vertex_type clip_vertex[3];
+		for (int k = 0; k < 3; ++k) {
+		    clip_vertex[k].position   = corner[k].position;
+		    clip_vertex[k].normal     = corner[k].normal;
+		    clip_vertex[k].worldpoint = corner[k].in_vertex;
+		    clip_vertex[k].color      = corner[k].color;
+		}
+		this->update_clip_planes();
+		this->clip_triangle(clip_vertex[0], clip_vertex[1], clip_vertex[2]);
+		return;
+	    }
 
-	    m_vertex_program->run(this->state(),
-				  in_vertex3, in_normal3, in_color3,
-				  out_vertex3, out_normal3,  out_color3);
-		
-	    //--- Initialize rasterizer with output from the vertex program
-	    m_rasterizer->init(out_vertex1, out_normal1, Worldvertex1, out_color1,
-			       out_vertex2, out_normal2, Worldvertex2, out_color2,
-			       out_vertex3, out_normal3, Worldvertex3, out_color3);
-		
-	    //--- Keep on processing fragments until there are none left
-	    while( m_rasterizer->more_fragments() )
+	    //--- Hand the triangle over to the rasterizer and fragment program
+	    this->rasterize_triangle(corner[0].vertex, corner[0].normal, corner[0].in_vertex, corner[0].color,
+				     corner[1].vertex, corner[1].normal, corner[1].in_vertex, corner[1].color,
+				     corner[2].vertex, corner[2].normal, corner[2].in_vertex, corner[2].color);
+	}
+
+	/**
+	 * Draw Indexed Triangles.
+	 * This method process a whole mesh of triangles which share their vertex
+	 * data. The vertex, normal and color buffers are indexed in parallel, and
+	 * every three consecutive entries of the index buffer make up one triangle.
+	 *
+	 * The vertex program is run exactly once for every vertex which is referenced
+	 * by the index buffer, and the output is kept in a post-transform array.
+	 * The triangles are then rasterized directly from the post-transform array,
+	 * such that a vertex shared by several triangles is only transformed once.
+	 * If the triangles are clipped, only those which cross the view volume are
+	 * clipped, the others use the post-transform array as it is.
+	 *
+	 * Note: If renderpipeline is not correctly setup then an exception is thrown.
+	 *       The buffers must have the same size, the number of indices must be a
+	 *       multiple of 3, and every index must refer to an existing vertex,
+	 *       otherwise an exception is thrown.
+	 *
+	 * @param vertex_buffer The vertex coordinates of the mesh.
+	 * @param normal_buffer The vertex normals of the mesh.
+	 * @param color_buffer  The vertex colors of the mesh.
+	 * @param index_buffer  The (0-based) indices of the triangle corners.
+	 */
+	void draw_indexed_triangles(std::vector<vector3_type> const& vertex_buffer,
+				    std::vector<vector3_type> const& normal_buffer,
+				    std::vector<vector3_type> const& color_buffer,
+				    std::vector<int> const& index_buffer)
+	{
+	    //--- Test if render pipeline was set up correctly
+	    if(!m_vertex_program)
+		throw std::logic_error("vertex program was not loaded");
+
+	    if(!m_rasterizer)
+		throw std::logic_error("rasterizer was not loaded");
+
+	    if(!m_fragment_program)
+		throw std::logic_error("fragment program was not loaded");
+
+	    //--- The vertex program gets the transformations once per draw call
+	    this->begin_vertex_batch();
+
+	    //--- Test if the buffers are consistent
+	    int vertex_count = static_cast<int>(vertex_buffer.size());
+	    if ((static_cast<int>(normal_buffer.size()) != vertex_count) ||
+		(static_cast<int>(color_buffer.size())  != vertex_count))
+		throw std::invalid_argument("RenderPipeline::draw_indexed_triangles(): buffers differ in size");
+
+	    if ((index_buffer.size() % 3) != 0)
+		throw std::invalid_argument("RenderPipeline::draw_indexed_triangles(): index count is not a multiple of 3");
+
+	    //--- Prepare the post-transform array, nothing is shaded yet
+	    this->m_post_vertices.resize(vertex_count);
+	    this->m_post_normals.resize(vertex_count);
+	    this->m_post_colors.resize(vertex_count);
+	    this->m_post_shaded.assign(vertex_count, false);
+
+	    bool clipping = m_vertex_program->homogeneous() && this->m_state.clipping();
+	    if (clipping) {
+		this->m_post_clip.resize(vertex_count);
+		this->m_post_outcodes.resize(vertex_count);
+		this->update_clip_planes();
+	    }
+
+	    int index_count = static_cast<int>(index_buffer.size());
 	    {
-		//--- get screen location of the current fragment
-		int screen_x = m_rasterizer->x();
-		int screen_y = m_rasterizer->y();
-		    
-		//--- extract old and new z value and perform a z-test
-		real_type z_old = m_zbuffer.read( screen_x, screen_y );
-		real_type z_new = m_rasterizer->depth();
-		
-		if(  this->state().ztest( z_old, z_new ) )
-		{
-		    //--- The fragment passed the z-test, now we need to ask
-		    //--- the fragment program to compute the color of the fragment.
-		    vector3_type out_color;               // uninitialized!
-		    out_color = m_rasterizer->color();    // now initialized!
-
-		    m_fragment_program->run(this->state(),
-					    m_rasterizer->position(),
-					    m_rasterizer->normal(),
-					    m_rasterizer->color(),
-					    out_color);
-			
-		    //--- Finally we write the new z-value to the z-buffer
-		    //--- and the new color to the frame buffer.
-		    m_zbuffer.write( screen_x, screen_y, z_new);
-		    this->write_pixel_to_frame_buffer(screen_x, screen_y, out_color);
+		GRAPHICS_STAGE_TIMER(this->m_statistics, vertex_stage);
+		for (int i = 0; i < index_count; ++i) {
+		    int index = index_buffer[i];
+		    if ((index < 0) || (index >= vertex_count))
+			throw std::out_of_range("RenderPipeline::draw_indexed_triangles(): index out of range");
+
+		    //--- Ask vertex program to process each unique vertex once
+		    if (!this->m_post_shaded[index]) {
+			if (clipping) {
+			    //--- Vertices inside the view volume are divided by w right away
+			    m_vertex_program->run_homogeneous(this->m_state,
+							      vertex_buffer[index], normal_buffer[index], color_buffer[index],
+							      this->m_post_clip[index],
+							      this->m_post_normals[index],
+							      this->m_post_colors[index]);
+			    this->m_post_outcodes[index] = this->outcode(this->m_post_clip[index]);
+			    if (this->m_post_outcodes[index] == 0)
+				this->m_post_vertices[index] = this->project(this->m_post_clip[index]);
+			}
+			else {
+			    m_vertex_program->run(this->m_state,
+						  vertex_buffer[index], normal_buffer[index], color_buffer[index],
+						  this->m_post_vertices[index],
+						  this->m_post_normals[index],
+						  this->m_post_colors[index]);
+			}
+			this->m_post_shaded[index] = true;
+			this->m_statistics.vertices_shaded += 1;
+		    }
+		}
+	    }
+
+	    //--- Rasterize the triangles straight from the post-transform array
+	    for (int i = 0; i < index_count; i += 3) {
+		int i1 = index_buffer[i];
+		int i2 = index_buffer[i + 1];
+		int i3 = index_buffer[i + 2];
+
+		this->m_statistics.triangles_submitted += 1;
+
+		if (clipping && (this->m_post_outcodes[i1] | this->m_post_outcodes[i2] | this->m_post_outcodes[i3])) {
+		    clip_vertex_type clip_vertex[3];
+		    int corner[3] = { i1, i2, i3 };
+		    for (int k = 0; k < 3; ++k) {
+			clip_vertex[k].position   = this->m_post_clip[corner[k]];
+			clip_vertex[k].normal     = this->m_post_normals[corner[k]];
+			clip_vertex[k].worldpoint = vertex_buffer[corner[k]];
+			clip_vertex[k].color      = this->m_post_colors[corner[k]];
+		    }
+		    this->clip_triangle(clip_vertex[0], clip_vertex[1], clip_vertex[2]);
+		    continue;
 		}
-		    
-		//--- We finished processing the fragment, so we
-		//--- can advance to the next fragment.
-		m_rasterizer->next_fragment();
+
+		this->rasterize_triangle(this->m_post_vertices[i1], this->m_post_normals[i1],
+					 vertex_buffer[i1], this->m_post_colors[i1],
+					 this->m_post_vertices[i2], this->m_post_normals[i2],
+					 vertex_buffer[i2], this->m_post_colors[i2],
+					 this->m_post_vertices[i3], this->m_post_normals[i3],
+					 vertex_buffer[i3], this->m_post_colors[i3]);
 	    }
 	}
 	
@@ -915,8 +1252,777 @@ namespace graphics
 	 */
 	void flush()
 	{
+	    this->resolve();
 	    this->m_frame_buffer.flush();
 	}
+
+	/**
+	 * Save to an Image File.
+	 * Like flush, but the framebuffer is written to a file instead of the
+	 * screen, so no window or OpenGL context is needed.
+	 *
+	 * @param filename  The name of the file, ending in .ppm, .png, or .exr.
+	 */
+	void save(std::string const& filename)
+	{
+	    this->resolve();
+	    this->m_frame_buffer.save(filename);
+	}
+
+    protected:
+	/**
+	 * Rasterize Triangle.
+	 * Feeds a triangle, which has already been processed by the vertex program,
+	 * to the rasterizer and runs the z-test and the fragment program on every
+	 * fragment it produces. In binning mode the triangle is put into the bins
+	 * instead, and is rasterized by resolve. Triangles without any area in
+	 * screen space are skipped, and so are triangles which are culled.
+	 *
+	 * @param out_vertex1    The screen-space coordinates of the first corner.
+	 * @param out_normal1    The normal of the first corner.
+	 * @param world_vertex1  The untransformed coordinates of the first corner.
+	 * @param out_color1     The color of the first corner.
+	 * @param out_vertex2    The screen-space coordinates of the second corner.
+	 * @param out_normal2    The normal of the second corner.
+	 * @param world_vertex2  The untransformed coordinates of the second corner.
+	 * @param out_color2     The color of the second corner.
+	 * @param out_vertex3    The screen-space coordinates of the third corner.
+	 * @param out_normal3    The normal of the third corner.
+	 * @param world_vertex3  The untransformed coordinates of the third corner.
+	 * @param out_color3     The color of the third corner.
+	 */
+	void rasterize_triangle(vector3_type const& out_vertex1,
+				vector3_type const& out_normal1,
+				vector3_type const& world_vertex1,
+				vector3_type const& out_color1,
+				vector3_type const& out_vertex2,
+				vector3_type const& out_normal2,
+				vector3_type const& world_vertex2,
+				vector3_type const& out_color2,
+				vector3_type const& out_vertex3,
+				vector3_type const& out_normal3,
+				vector3_type const& world_vertex3,
+				vector3_type const& out_color3)
+	{
+	    //--- Only fragments on the screen are of any use, unless the
+	    //--- unit length magnifies them.
+	    int x_min, y_min, x_max, y_max;
+	    this->scissor_rectangle(x_min, y_min, x_max, y_max);
+
+	    //--- Everything up to the first fragment is timed as setup
+	    {
+		GRAPHICS_STAGE_TIMER(this->m_statistics, setup_stage);
+
+		//--- A triangle with collinear corners does not cover anything
+		real_type area = (out_vertex2[1] - out_vertex1[1]) * (out_vertex3[2] - out_vertex1[2])
+			       - (out_vertex3[1] - out_vertex1[1]) * (out_vertex2[2] - out_vertex1[2]);
+		if (area == 0) {
+		    this->m_statistics.triangles_degenerate += 1;
+		    return;
+		}
+
+		//--- Skip the triangle if it faces the wrong way or is out of sight
+		if (this->triangle_culled(out_vertex1, out_vertex2, out_vertex3)) {
+		    this->m_statistics.triangles_culled += 1;
+		    return;
+		}
+
+		if (this->m_unitlength == 1) {
+		    //--- Skip the triangle if it is behind what has been drawn so far
+		    if (this->triangle_hidden(out_vertex1, out_vertex2, out_vertex3, x_min, y_min, x_max, y_max)) {
+			this->m_statistics.triangles_culled += 1;
+			return;
+		    }
+		}
+
+		//--- In binning mode the triangle is rasterized later by resolve
+		if (this->m_binning && (this->m_unitlength == 1)) {
+		    typename tile_binner_type::triangle_type triangle;
+		    triangle.vertex[0]     = out_vertex1;
+		    triangle.vertex[1]     = out_vertex2;
+		    triangle.vertex[2]     = out_vertex3;
+		    triangle.normal[0]     = out_normal1;
+		    triangle.normal[1]     = out_normal2;
+		    triangle.normal[2]     = out_normal3;
+		    triangle.worldpoint[0] = world_vertex1;
+		    triangle.worldpoint[1] = world_vertex2;
+		    triangle.worldpoint[2] = world_vertex3;
+		    triangle.color[0]      = out_color1;
+		    triangle.color[1]      = out_color2;
+		    triangle.color[2]      = out_color3;
+		    triangle.rasterizer       = this->m_rasterizer;
+		    triangle.fragment_program = this->m_fragment_program;
+
+		    this->m_binner.bin(triangle);
+		    return;
+		}
+
+		m_rasterizer->scissor(x_min, y_min, x_max, y_max);
+		m_rasterizer->occlusion_query((this->m_unitlength == 1) ? &this->m_zbuffer : 0);
+
+		//--- Initialize rasterizer with output from the vertex program
+		m_rasterizer->init(out_vertex1, out_normal1, world_vertex1, out_color1,
+				   out_vertex2, out_normal2, world_vertex2, out_color2,
+				   out_vertex3, out_normal3, world_vertex3, out_color3);
+	    }
+
+	    this->shade_fragments(*m_rasterizer, *m_fragment_program, x_min, y_min, x_max, y_max,
+				  this->m_statistics);
+	}
+
+	/// The number of planes of the view volume.
+	enum { clip_plane_count = 6 };
+
+	/// A triangle cut by all six planes has at most 3 + 6 corners.
+	enum { max_clip_vertices = 12 };
+
+	/// A vertex in homogeneous screen coordinates, with its attributes.
+	struct clip_vertex_type
+	{
+	    vector4_type position;
+	    vector3_type normal;
+	    vector3_type worldpoint;
+	    vector3_type color;
+	};
+
+	/**
+	 * Clip Triangle.
+	 * Clips a triangle in homogeneous screen coordinates against the view volume
+	 * with the Sutherland-Hodgman algorithm, and hands the resulting polygon to
+	 * rasterize_triangle as a fan of triangles. The other vertex attributes are
+	 * interpolated linearly in homogeneous coordinates, like the position.
+	 *
+	 * A triangle inside the view volume is passed on as it is, and a triangle
+	 * entirely outside one of the planes is culled. update_clip_planes must have
+	 * been invoked since the GraphicsState was last changed.
+	 *
+	 * @param vertex1  The first corner, as computed by VertexProgram::run_homogeneous.
+	 * @param vertex2  The second corner.
+	 * @param vertex3  The third corner.
+	 */
+	void clip_triangle(clip_vertex_type const& vertex1, clip_vertex_type const& vertex2,
+			   clip_vertex_type const& vertex3)
+	{
+	    clip_vertex_type polygon[2][max_clip_vertices];
+	    vector3_type     screen[max_clip_vertices];
+	    int              current = 0;
+	    int              count   = 3;
+	    {
+		GRAPHICS_STAGE_TIMER(this->m_statistics, setup_stage);
+
+		int code1 = this->outcode(vertex1.position);
+		int code2 = this->outcode(vertex2.position);
+		int code3 = this->outcode(vertex3.position);
+		if ((code1 & code2 & code3) != 0) {
+		    this->m_statistics.triangles_culled += 1;
+		    return;
+		}
+
+		polygon[0][0] = vertex1;
+		polygon[0][1] = vertex2;
+		polygon[0][2] = vertex3;
+
+		//--- Only the planes which are crossed by an edge need to be clipped against
+		int crossed = code1 | code2 | code3;
+		for (int plane = 0; (plane < clip_plane_count) && (crossed != 0); ++plane) {
+		    if ((crossed & (1 << plane)) == 0)
+			continue;
+
+		    clip_vertex_type const* in  = polygon[current];
+		    clip_vertex_type*       out = polygon[1 - current];
+		    int out_count = 0;
+		    for (int i = 0; i < count; ++i) {
+			clip_vertex_type const& a = in[i];
+			clip_vertex_type const& b = in[(i + 1) % count];
+			real_type distance_a = this->plane_distance(plane, a.position);
+			real_type distance_b = this->plane_distance(plane, b.position);
+
+			if (distance_a >= 0)
+			    out[out_count++] = a;
+			if ((distance_a >= 0) != (distance_b >= 0))
+			    this->intersect(a, b, distance_a / (distance_a - distance_b), out[out_count++]);
+		    }
+		    count   = out_count;
+		    current = 1 - current;
+
+		    if (count < 3) {
+			this->m_statistics.triangles_culled += 1;
+			return;
+		    }
+		}
+		if (crossed != 0)
+		    this->m_statistics.triangles_clipped += 1;
+
+		for (int i = 0; i < count; ++i)
+		    screen[i] = this->project(polygon[current][i].position);
+	    }
+
+	    clip_vertex_type const* corner = polygon[current];
+	    for (int i = 1; i + 1 < count; ++i) {
+		this->rasterize_triangle(screen[0],     corner[0].normal,     corner[0].worldpoint,     corner[0].color,
+					 screen[i],     corner[i].normal,     corner[i].worldpoint,     corner[i].color,
+					 screen[i + 1], corner[i + 1].normal, corner[i + 1].worldpoint, corner[i + 1].color);
+	    }
+	}
+
+	/// The number of vertices kept by the post-transform cache of draw_triangle.
+	enum { vertex_cache_size = 16 };
+
+	/// A vertex in the post-transform cache, with the input it was shaded from.
+	struct cached_vertex_type
+	{
+	    vector3_type in_vertex;
+	    vector3_type in_normal;
+	    vector3_type in_color;
+	    vector4_type position;    ///< The output of run_homogeneous, if the triangles are clipped.
+	    vector3_type vertex;      ///< The output of run, otherwise.
+	    vector3_type normal;
+	    vector3_type color;
+	};
+
+	/**
+	 * Test if two vectors are bitwise the same, which is what the vertex
+	 * cache needs to know to be sure that the vertex program gives the same.
+	 */
+	static bool same_vector(vector3_type const& a, vector3_type const& b)
+	{
+	    return std::memcmp(&a[1], &b[1], 3 * sizeof(real_type)) == 0;
+	}
+
+	/**
+	 * Shade a Vertex through the Cache.
+	 * Looks the vertex up in the post-transform cache, and runs the vertex
+	 * program on it if it is not there. The oldest vertex in the cache is
+	 * replaced by the new one. The cache must have been checked against the
+	 * GraphicsState beforehand.
+	 *
+	 * @param clipping  true if the vertex is run through run_homogeneous, false if through run.
+	 * @return The entry of the cache which holds the shaded vertex.
+	 */
+	cached_vertex_type const& shade_cached_vertex(vector3_type const& in_vertex,
+						      vector3_type const& in_normal,
+						      vector3_type const& in_color,
+						      bool clipping)
+	{
+	    for (int i = 0; i < this->m_vertex_cache_count; ++i) {
+		cached_vertex_type const& entry = this->m_vertex_cache[i];
+		if (same_vector(entry.in_vertex, in_vertex) && same_vector(entry.in_normal, in_normal) &&
+		    same_vector(entry.in_color, in_color)) {
+		    this->m_statistics.vertex_cache_hits += 1;
+		    return entry;
+		}
+	    }
+
+	    //--- The state is only copied when the first vertex goes into an empty cache
+	    if (this->m_vertex_cache_count == 0)
+		this->m_vertex_cache_state = this->m_state;
+
+	    //--- The vertex is shaded aside, so the cache is left as it was if the vertex program throws
+	    cached_vertex_type shaded;
+	    shaded.in_vertex = in_vertex;
+	    shaded.in_normal = in_normal;
+	    shaded.in_color  = in_color;
+	    if (clipping)
+		m_vertex_program->run_homogeneous(this->m_state, in_vertex, in_normal, in_color,
+						  shaded.position, shaded.normal, shaded.color);
+	    else
+		m_vertex_program->run(this->m_state, in_vertex, in_normal, in_color,
+				      shaded.vertex, shaded.normal, shaded.color);
+	    this->m_statistics.vertices_shaded += 1;
+
+	    cached_vertex_type& entry = this->m_vertex_cache[this->m_vertex_cache_next];
+	    entry = shaded;
+	    this->m_vertex_cache_next = (this->m_vertex_cache_next + 1) % vertex_cache_size;
+	    if (this->m_vertex_cache_count < vertex_cache_size)
+		this->m_vertex_cache_count += 1;
+	    return entry;
+	}
+
+	/**
+	 * Hand the transformations of the state over to the vertex program, see
+	 * VertexProgram::begin_batch. The state caches the products, so they are
+	 * only computed again if the transformations have changed.
+	 */
+	void begin_vertex_batch()
+	{
+	    graphics_state_type const& state = this->m_state;
+	    this->m_vertex_program->begin_batch(state, state.model_projection(), state.normal_matrix());
+	}
+
+	/**
+	 * Update the Clip Planes.
+	 * The view volume is the canonical view volume -w <= x, y <= w, -w <= z <= 0,
+	 * mapped to homogeneous screen coordinates by the window-viewport transformation.
+	 * The planes of the sides are moved out to a guard band of twice the size of
+	 * the viewport, such that triangles which stick out of the screen are left to
+	 * the scissor test of the rasterizers, and only huge ones are cut down.
+	 */
+	void update_clip_planes()
+	{
+	    real_type const guard = 2;
+	    real_type const canonical[clip_plane_count][4] = {
+		{  1,  0,  0, guard },    // left
+		{ -1,  0,  0, guard },    // right
+		{  0,  1,  0, guard },    // bottom
+		{  0, -1,  0, guard },    // top
+		{  0,  0,  1, 1     },    // back,  z >= -w
+		{  0,  0, -1, 0     }     // front, z <= 0
+	    };
+
+	    //--- A plane p of the canonical view volume is p * inv_window_viewport in screen coordinates
+	    graphics_state_type const& state = this->m_state;
+	    matrix4x4_type const& inverse = state.inv_window_viewport();
+	    for (int plane = 0; plane < clip_plane_count; ++plane) {
+		for (int j = 1; j <= 4; ++j) {
+		    real_type sum = 0;
+		    for (int i = 1; i <= 4; ++i)
+			sum += canonical[plane][i - 1] * inverse[i][j];
+		    this->m_clip_planes[plane][j] = sum;
+		}
+	    }
+	}
+
+	/**
+	 * The signed distance (scaled) of a homogeneous point from a clip plane,
+	 * which is negative if the point is outside.
+	 */
+	real_type plane_distance(int plane, vector4_type const& position) const
+	{
+	    vector4_type const& p = this->m_clip_planes[plane];
+	    return p[1] * position[1] + p[2] * position[2] + p[3] * position[3] + p[4] * position[4];
+	}
+
+	/**
+	 * The Outcode of a homogeneous point.
+	 * @return A bit mask of the clip planes which the point is outside of.
+	 */
+	int outcode(vector4_type const& position) const
+	{
+	    int code = 0;
+	    for (int plane = 0; plane < clip_plane_count; ++plane) {
+		if (this->plane_distance(plane, position) < 0)
+		    code |= (1 << plane);
+	    }
+	    return code;
+	}
+
+	/**
+	 * Divide a homogeneous point by its fourth coordinate.
+	 */
+	vector3_type project(vector4_type const& position) const
+	{
+	    vector3_type point;
+	    real_type    w = position[4];
+	    for (int i = 1; i <= 3; ++i)
+		point[i] = position[i] / w;
+	    return point;
+	}
+
+	/**
+	 * Interpolate between two clip vertices: result = a + t * (b - a).
+	 */
+	static void intersect(clip_vertex_type const& a, clip_vertex_type const& b, real_type t,
+			      clip_vertex_type& result)
+	{
+	    for (int i = 1; i <= 4; ++i)
+		result.position[i] = a.position[i] + t * (b.position[i] - a.position[i]);
+	    for (int i = 1; i <= 3; ++i) {
+		result.normal[i]     = a.normal[i]     + t * (b.normal[i]     - a.normal[i]);
+		result.worldpoint[i] = a.worldpoint[i] + t * (b.worldpoint[i] - a.worldpoint[i]);
+		result.color[i]      = a.color[i]      + t * (b.color[i]      - a.color[i]);
+	    }
+	}
+
+	/**
+	 * Culling Stage.
+	 * Tests a triangle against the culling parameters of the GraphicsState:
+	 * its winding in screen space, the viewport, and the depth range. The
+	 * viewport is only tested if the unit length is 1, otherwise the screen
+	 * is magnified. Triangles with NaN coordinates are never culled.
+	 *
+	 * The winding is taken from the corners rounded to whole pixels, which
+	 * is the triangle the rasterizers draw. A triangle seen almost edge-on
+	 * can turn over when its corners are rounded, and it is the faces which
+	 * face the viewer after rounding that cover the silhouette.
+	 * A triangle which rounds to a line is not culled by its winding.
+	 *
+	 * @param vertex1  The screen-space coordinates of the first corner.
+	 * @param vertex2  The screen-space coordinates of the second corner.
+	 * @param vertex3  The screen-space coordinates of the third corner.
+	 *
+	 * @return true if the triangle can be skipped, false otherwise.
+	 */
+	bool triangle_culled(vector3_type const& vertex1, vector3_type const& vertex2, vector3_type const& vertex3) const
+	{
+	    graphics_state_type const& state = this->m_state;
+
+	    if (state.cull_face() != graphics_state_type::cull_none) {
+		//--- Whole pixels, kept in doubles so the area is exact
+		double x1 = round(vertex1[1]), y1 = round(vertex1[2]);
+		double x2 = round(vertex2[1]), y2 = round(vertex2[2]);
+		double x3 = round(vertex3[1]), y3 = round(vertex3[2]);
+		double area = (x2 - x1) * (y3 - y1) - (x3 - x1) * (y2 - y1);
+		if ((area > 0) || (area < 0)) {
+		    bool counter_clockwise = (area > 0);
+		    bool front = (counter_clockwise == (state.front_face() == graphics_state_type::counter_clockwise));
+		    if (front == (state.cull_face() == graphics_state_type::cull_front))
+			return true;
+		}
+	    }
+
+	    if (state.viewport_culling() && (this->m_unitlength == 1)) {
+		//--- The rasterizers round the vertices, so a pixel of slack is added
+		real_type left   = -1;
+		real_type bottom = -1;
+		real_type right  = real_type(this->m_frame_buffer.width());
+		real_type top    = real_type(this->m_frame_buffer.height());
+		if (((vertex1[1] < left)   && (vertex2[1] < left)   && (vertex3[1] < left))   ||
+		    ((vertex1[1] > right)  && (vertex2[1] > right)  && (vertex3[1] > right))  ||
+		    ((vertex1[2] < bottom) && (vertex2[2] < bottom) && (vertex3[2] < bottom)) ||
+		    ((vertex1[2] > top)    && (vertex2[2] > top)    && (vertex3[2] > top)))
+		    return true;
+	    }
+
+	    if (state.depth_culling()) {
+		if (((vertex1[3] > 0)  && (vertex2[3] > 0)  && (vertex3[3] > 0)) ||
+		    ((vertex1[3] < -1) && (vertex2[3] < -1) && (vertex3[3] < -1)))
+		    return true;
+	    }
+
+	    return false;
+	}
+
+	/**
+	 * Hidden Triangle Query.
+	 * Asks the depth pyramid of the z-buffer if every fragment of a triangle
+	 * inside a rectangle would fail the z-test. The rasterizers round the
+	 * vertices, so a pixel of slack is added to the bounding box.
+	 *
+	 * @param vertex1  The screen-space coordinates of the first corner.
+	 * @param vertex2  The screen-space coordinates of the second corner.
+	 * @param vertex3  The screen-space coordinates of the third corner.
+	 * @param x_min    The smallest x-coordinate of the rectangle.
+	 * @param y_min    The smallest y-coordinate of the rectangle.
+	 * @param x_max    The largest x-coordinate of the rectangle.
+	 * @param y_max    The largest y-coordinate of the rectangle.
+	 *
+	 * @return true if the triangle is hidden, false if it might be visible.
+	 */
+	bool triangle_hidden(vector3_type const& vertex1, vector3_type const& vertex2, vector3_type const& vertex3,
+			     int x_min, int y_min, int x_max, int y_max) const
+	{
+	    real_type x_low  = std::min(std::min(vertex1[1], vertex2[1]), vertex3[1]);
+	    real_type x_high = std::max(std::max(vertex1[1], vertex2[1]), vertex3[1]);
+	    real_type y_low  = std::min(std::min(vertex1[2], vertex2[2]), vertex3[2]);
+	    real_type y_high = std::max(std::max(vertex1[2], vertex2[2]), vertex3[2]);
+	    real_type z_low  = std::min(std::min(vertex1[3], vertex2[3]), vertex3[3]);
+	    real_type z_high = std::max(std::max(vertex1[3], vertex2[3]), vertex3[3]);
+
+	    //--- Triangles with NaN coordinates are left to the rasterizer
+	    if (!(x_low <= x_high) || !(y_low <= y_high) || !(z_low <= z_high))
+		return false;
+
+	    //--- The interpolated depths of the fragments may round past those of the vertices
+	    z_low  = static_cast<real_type>(z_low  - OcclusionQuery<math_types>::depth_slack());
+	    z_high = static_cast<real_type>(z_high + OcclusionQuery<math_types>::depth_slack());
+
+	    //--- Clamp before converting, such that huge coordinates do not overflow
+	    real_type left   = std::floor(x_low)  - 1;
+	    real_type bottom = std::floor(y_low)  - 1;
+	    real_type right  = std::ceil(x_high)  + 1;
+	    real_type top    = std::ceil(y_high)  + 1;
+	    left   = std::min(std::max(left,   real_type(x_min)), real_type(x_max) + 1);
+	    bottom = std::min(std::max(bottom, real_type(y_min)), real_type(y_max) + 1);
+	    right  = std::max(std::min(right,  real_type(x_max)), real_type(x_min) - 1);
+	    top    = std::max(std::min(top,    real_type(y_max)), real_type(y_min) - 1);
+
+	    return this->m_zbuffer.hidden(static_cast<int>(left),  static_cast<int>(bottom),
+					  static_cast<int>(right), static_cast<int>(top),
+					  z_low, z_high);
+	}
+
+	/**
+	 * Shade Fragments.
+	 * Runs the z-test and the fragment program on every fragment produced by
+	 * an initialized rasterizer. Fragments outside the given rectangle are skipped.
+	 *
+	 * The fragments are fetched from the rasterizer a span at a time. The
+	 * whole span is z-tested first, and the fragments which pass are moved to
+	 * the front of it. If the rasterizer defers the attributes, they are only
+	 * interpolated for those fragments. If the fragment program can shade a
+	 * batch of fragments at once, the fragments are shaded in batches.
+	 * The z-buffer is written during the test and the colors are written in
+	 * the same order, so the result is the same as if every fragment was
+	 * tested and shaded before the next one.
+	 *
+	 * @param rasterizer        A rasterizer which has been initialized.
+	 * @param fragment_program  The fragment program which computes the colors.
+	 * @param x_min             The smallest x-coordinate of a fragment to be shaded.
+	 * @param y_min             The smallest y-coordinate of a fragment to be shaded.
+	 * @param x_max             The largest x-coordinate of a fragment to be shaded.
+	 * @param y_max             The largest y-coordinate of a fragment to be shaded.
+	 * @param statistics        Receives the counts of the fragments.
+	 */
+	void shade_fragments(rasterizer_type& rasterizer, fragment_program_type& fragment_program,
+			     int x_min, int y_min, int x_max, int y_max, statistics_type& statistics)
+	{
+	    bool const batched  = fragment_program.batched();
+	    bool const deferred = rasterizer.deferred_attributes();
+
+	    fragment_span_type span;
+
+	    //--- Value-initialized, so unused entries hold defined values
+	    fragment_batch_type batch = fragment_batch_type();
+	    int batch_x[fragment_program_type::batch_size];
+	    int batch_y[fragment_program_type::batch_size];
+	    batch.count = 0;
+
+	    vector3_type in_position;
+	    vector3_type in_normal;
+	    vector3_type in_color;
+	    vector3_type out_color;
+
+	    //--- Keep on processing fragments until there are none left
+	    while( true )
+	    {
+		int passed = 0;
+		int tested = 0;
+		//--- Fetch the next span and z-test it
+		{
+		    GRAPHICS_STAGE_TIMER(statistics, raster_stage);
+		    if (rasterizer.next_fragments(span) <= 0)
+			break;
+
+		    for (int j = 0; j < span.count; ++j) {
+			//--- get screen location of the current fragment
+			int screen_x = span.x[j];
+			int screen_y = span.y[j];
+
+			if ((screen_x < x_min) || (screen_x > x_max) || (screen_y < y_min) || (screen_y > y_max))
+			    continue;
+
+			//--- extract old and new z value and perform a z-test
+			real_type z_old = m_zbuffer.read( screen_x, screen_y );
+			real_type z_new = span.depth[j];
+
+			++tested;
+			if( !this->m_state.ztest( z_old, z_new ) )
+			    continue;
+
+			//--- The fragment passed, write its z-value and keep it
+			m_zbuffer.write( screen_x, screen_y, z_new);
+			if (passed < j) {
+			    span.x[passed] = screen_x;
+			    span.y[passed] = screen_y;
+			    if (!deferred) {
+				for (int i = 0; i < 3; ++i) {
+				    span.position[i][passed] = span.position[i][j];
+				    span.normal[i][passed]   = span.normal[i][j];
+				    span.color[i][passed]    = span.color[i][j];
+				}
+			    }
+			}
+			++passed;
+		    }
+		}
+		statistics.fragments_generated += span.count;
+		statistics.fragments_passed    += passed;
+		statistics.fragments_failed    += tested - passed;
+		statistics.fragments_shaded    += passed;
+		span.count = passed;
+
+		GRAPHICS_STAGE_TIMER(statistics, shade_stage);
+		if (deferred && (passed > 0)) {
+		    rasterizer.interpolate_attributes(span);
+		}
+
+		for (int j = 0; j < span.count; ++j) {
+		    int screen_x = span.x[j];
+		    int screen_y = span.y[j];
+
+		    if (batched) {
+			//--- Queue the fragment, and shade the batch when it is full
+			for (int i = 0; i < 3; ++i) {
+			    batch.position[i][batch.count] = span.position[i][j];
+			    batch.normal[i][batch.count]   = span.normal[i][j];
+			    batch.color[i][batch.count]    = span.color[i][j];
+			}
+			batch_x[batch.count] = screen_x;
+			batch_y[batch.count] = screen_y;
+			if (++batch.count == fragment_program_type::batch_size) {
+			    this->shade_batch(fragment_program, batch, batch_x, batch_y);
+			}
+		    }
+		    else {
+			//--- The fragment passed the z-test, now we need to ask
+			//--- the fragment program to compute the color of the fragment.
+			for (int i = 0; i < 3; ++i) {
+			    in_position[i + 1] = span.position[i][j];
+			    in_normal[i + 1]   = span.normal[i][j];
+			    in_color[i + 1]    = span.color[i][j];
+			}
+			out_color = in_color;
+
+			fragment_program.run(this->m_state, in_position, in_normal, in_color, out_color);
+
+			//--- Finally we write the new color to the frame buffer.
+			this->write_pixel_to_frame_buffer(screen_x, screen_y, out_color);
+		    }
+		}
+	    }
+
+	    if (batch.count > 0) {
+		GRAPHICS_STAGE_TIMER(statistics, shade_stage);
+		this->shade_batch(fragment_program, batch, batch_x, batch_y);
+	    }
+	}
+
+	/**
+	 * Shade Batch.
+	 * Runs the fragment program on a batch of fragments, writes their colors
+	 * to the frame buffer, and empties the batch.
+	 *
+	 * @param fragment_program  The fragment program which computes the colors.
+	 * @param batch             The fragments which have passed the z-test.
+	 * @param batch_x           The x-coordinates of the fragments.
+	 * @param batch_y           The y-coordinates of the fragments.
+	 */
+	void shade_batch(fragment_program_type& fragment_program, fragment_batch_type& batch,
+			 int const* batch_x, int const* batch_y)
+	{
+	    fragment_program.run_batch(this->m_state, batch);
+
+	    vector3_type out_color;
+	    for (int j = 0; j < batch.count; ++j) {
+		for (int i = 0; i < 3; ++i) {
+		    out_color[i + 1] = batch.out_color[i][j];
+		}
+		this->write_pixel_to_frame_buffer(batch_x[j], batch_y[j], out_color);
+	    }
+	    batch.count = 0;
+	}
+
+	/**
+	 * Rasterize Tiles.
+	 * The body of a worker thread in binning mode. It keeps taking the next
+	 * unprocessed tile and rasterizes the triangles in its bin, until no
+	 * tiles are left.
+	 *
+	 * @param next_tile   The index of the next unprocessed tile, shared by all workers.
+	 * @param use_clones  If true the worker rasterizes with its own clones of the
+	 *                    rasterizers, otherwise the loaded rasterizers are used.
+	 * @param error       Receives the message of an exception, if one is thrown.
+	 * @param statistics  Receives the counts of the fragments of the worker.
+	 */
+	void rasterize_tiles(std::atomic<int>& next_tile, bool use_clones, std::string& error,
+			     statistics_type& statistics)
+	{
+	    std::vector<rasterizer_type*> const& rasterizers = this->m_binner.rasterizers();
+	    std::vector<rasterizer_type*> clones(rasterizers.size(), static_cast<rasterizer_type*>(0));
+
+	    try {
+		for (int i = 0; use_clones && (i < static_cast<int>(rasterizers.size())); ++i)
+		    clones[i] = rasterizers[i]->clone();
+
+		//--- No block of the depth pyramid is shared by two tiles, see enable_binning
+		assert(this->m_binner.tile_size() % zbuffer_type::pyramid_size == 0);
+
+		int tile_count = this->m_binner.tile_count();
+		for (int tile = next_tile++; tile < tile_count; tile = next_tile++) {
+		    int x_min, y_min, x_max, y_max;
+		    this->m_binner.tile_bounds(tile, x_min, y_min, x_max, y_max);
+
+		    std::vector<int> const& bin = this->m_binner.triangles_in(tile);
+		    for (int i = 0; i < static_cast<int>(bin.size()); ++i) {
+			typename tile_binner_type::triangle_type const& triangle = this->m_binner.triangle(bin[i]);
+
+			rasterizer_type* rasterizer = triangle.rasterizer;
+			if (use_clones) {
+			    int r = static_cast<int>(std::find(rasterizers.begin(), rasterizers.end(), rasterizer)
+						     - rasterizers.begin());
+			    rasterizer = clones[r];
+			}
+
+			{
+			    GRAPHICS_STAGE_TIMER(statistics, setup_stage);
+			    if (this->triangle_hidden(triangle.vertex[0], triangle.vertex[1],
+						      triangle.vertex[2], x_min, y_min, x_max, y_max))
+				continue;
+
+			    rasterizer->scissor(x_min, y_min, x_max, y_max);
+			    rasterizer->occlusion_query(&this->m_zbuffer);
+			    rasterizer->init(triangle.vertex[0], triangle.normal[0], triangle.worldpoint[0], triangle.color[0],
+					     triangle.vertex[1], triangle.normal[1], triangle.worldpoint[1], triangle.color[1],
+					     triangle.vertex[2], triangle.normal[2], triangle.worldpoint[2], triangle.color[2]);
+			}
+
+			this->shade_fragments(*rasterizer, *triangle.fragment_program, x_min, y_min, x_max, y_max,
+					      statistics);
+		    }
+		}
+	    }
+	    catch (std::exception const& exception) {
+		error = exception.what();
+		//--- Make the other workers run out of tiles
+		next_tile = this->m_binner.tile_count();
+	    }
+	    catch (...) {
+		//--- Anything else would terminate a worker thread
+		error = "unknown exception";
+		next_tile = this->m_binner.tile_count();
+	    }
+
+	    for (int i = 0; i < static_cast<int>(clones.size()); ++i)
+		delete clones[i];
+	}
+
+	/// The planes of the view volume in homogeneous screen coordinates.
+	vector4_type              m_clip_planes[clip_plane_count];
+
+	/// Post-transform vertex coordinates used by draw_indexed_triangles.
+	std::vector<vector3_type> m_post_vertices;
+
+	/// Post-transform homogeneous coordinates, used if the triangles are clipped.
+	std::vector<vector4_type> m_post_clip;
+
+	/// The outcodes of the post-transform homogeneous coordinates.
+	std::vector<int>          m_post_outcodes;
+
+	/// Post-transform vertex normals used by draw_indexed_triangles.
+	std::vector<vector3_type> m_post_normals;
+
+	/// Post-transform vertex colors used by draw_indexed_triangles.
+	std::vector<vector3_type> m_post_colors;
+
+	/// Tells which entries of the post-transform array have been computed.
+	std::vector<bool>         m_post_shaded;
+
+	/// Sorts the triangles into tiles in binning mode.
+	tile_binner_type          m_binner;
+
+	/// True if the render pipeline is in binning mode.
+	bool                      m_binning;
+
+	/// The number of worker threads used by resolve.
+	int                       m_thread_count;
+
+	/// The work done since the last clear.
+	statistics_type           m_statistics;
+
+	/// The post-transform cache of draw_triangle, a ring buffer of the last shaded vertices.
+	cached_vertex_type        m_vertex_cache[vertex_cache_size];
+
+	/// The number of vertices in the cache.
+	int                       m_vertex_cache_count;
+
+	/// The entry of the cache which is replaced next.
+	int                       m_vertex_cache_next;
+
+	/// The GraphicsState which the vertices in the cache were shaded with.
+	graphics_state_type       m_vertex_cache_state;
+
+	/// True if the cache has been checked against the state since state() last handed it out.
+	bool                      m_vertex_cache_checked;
     };
 }// end namespace graphics
 
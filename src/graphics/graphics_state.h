@@ -5,6 +5,8 @@
 // Copyright (C) 2007 Department of Computer Science, University of Copenhagen
 //
 
+#include <cstring>
+
 #include "graphics/graphics.h"
 #include "solution/transformations.h"
 
@@ -13,6 +15,16 @@ namespace graphics
 {
     /**
      * Keeps the information of what state the graphics pipeline is in at all times.
+     *
+     * The inverse of every transformation is computed the first time it is
+     * needed after the transformation has changed, unless it is given along
+     * with the transformation, e.g. by set_model(M, InvM), or assigned to the
+     * writable inverse. Every inverse remembers the matrix it belongs to, so
+     * it does not matter if a transformation is changed by a setter or
+     * through its writable reference. The writable inverses are only meant
+     * for assigning, and are not computed; an inverse is read through a
+     * read-only state. The cached matrices are computed by the thread which
+     * asks first, so only one thread may ask at a time.
      */
     template< typename math_types >
     class GraphicsState
@@ -43,6 +55,17 @@ namespace graphics
 	 */
 	typedef typename math_types::matrix4x4_type matrix4x4_type;
 
+	/**
+	 * Which triangles are culled by their winding in screen space.
+	 */
+	enum cull_face_type { cull_none, cull_back, cull_front };
+
+	/**
+	 * The winding of the front faces of triangles in screen space,
+	 * where the y-axis points upwards.
+	 */
+	enum front_face_type { counter_clockwise, clockwise };
+
     public:
 	/**
 	 * Default constructor. set all transformations to the identity.
@@ -67,6 +90,25 @@ namespace graphics
 	    this->m_projection     = Id;
 	    this->m_inv_projection = Id;
 
+	    this->m_inv_model_of            = Id;
+	    this->m_inv_view_orientation_of = Id;
+	    this->m_inv_view_projection_of  = Id;
+	    this->m_inv_window_viewport_of  = Id;
+	    this->m_inv_projection_of       = Id;
+
+	    this->m_normal_matrix                  = Id;
+	    this->m_normal_matrix_of               = Id;
+	    this->m_model_projection               = Id;
+	    this->m_model_projection_of_model      = Id;
+	    this->m_model_projection_of_projection = Id;
+
+	    /// Culling is off, except for triangles outside the viewport.
+	    this->m_cull_face         = cull_none;
+	    this->m_front_face        = counter_clockwise;
+	    this->m_viewport_culling  = true;
+	    this->m_depth_culling     = false;
+	    this->m_clipping          = true;
+
 	    /// Reset all the Phong parameters to some useful values.
 	    /// ...
 	}
@@ -86,12 +128,20 @@ namespace graphics
 	/**
 	 * The inverse model transformation
 	 */
-	matrix4x4_type const& inv_model() const { return this->m_inv_model; }
+	matrix4x4_type const& inv_model() const
+	{
+	    return this->inverse(this->m_model, this->m_inv_model, this->m_inv_model_of);
+	}
 
 	/**
 	 * The inverse model transformation
+	 * A matrix assigned to it is taken to be the inverse of the current model().
 	 */
-	matrix4x4_type&       inv_model()       { return this->m_inv_model; }
+	matrix4x4_type& inv_model()
+	{
+	    this->m_inv_model_of = this->m_model;
+	    return this->m_inv_model;
+	}
 
         /**
 	 * Transform from World-coordinates to Eye-coordinates.
@@ -108,12 +158,20 @@ namespace graphics
 	/**
 	 * The inverse of the view_orientation matrix.
 	 */
-	matrix4x4_type const& inv_view_orientation() const { return this->m_inv_view_orientation; }
+	matrix4x4_type const& inv_view_orientation() const
+	{
+	    return this->inverse(this->m_view_orientation, this->m_inv_view_orientation, this->m_inv_view_orientation_of);
+	}
 
         /**
 	 * The inverse of the view_orientation matrix.
+	 * A matrix assigned to it is taken to be the inverse of the current view_orientation().
 	 */
-	matrix4x4_type& inv_view_orientation()         { return this->m_inv_view_orientation; }
+	matrix4x4_type& inv_view_orientation()
+	{
+	    this->m_inv_view_orientation_of = this->m_view_orientation;
+	    return this->m_inv_view_orientation;
+	}
         /**
 	 * Transform from Eye-coordinates to Canonical-coordinates.
 	 * @return A read-only reference to the matrix which transforms from the Eye-coordinate system to the Canonical-coordinate system.
@@ -129,12 +187,20 @@ namespace graphics
         /**
 	 * The inverse of the view_projection matrix.
 	 */
-	matrix4x4_type const& inv_view_projection() const { return this->m_inv_view_projection; }
+	matrix4x4_type const& inv_view_projection() const
+	{
+	    return this->inverse(this->m_view_projection, this->m_inv_view_projection, this->m_inv_view_projection_of);
+	}
 
 	/**
 	 * The inverse of the view_projection matrix.
+	 * A matrix assigned to it is taken to be the inverse of the current view_projection().
 	 */
-	matrix4x4_type&       inv_view_projection()       { return this->m_inv_view_projection; }
+	matrix4x4_type& inv_view_projection()
+	{
+	    this->m_inv_view_projection_of = this->m_view_projection;
+	    return this->m_inv_view_projection;
+	}
 
         /**
 	 * Transform from Canonical-coordinates to Screen-coordinates.
@@ -151,12 +217,20 @@ namespace graphics
 	/**
 	 * The inverse of the window_viewport transformation.
 	 */
-	matrix4x4_type const& inv_window_viewport() const { return this->m_inv_window_viewport; }
+	matrix4x4_type const& inv_window_viewport() const
+	{
+	    return this->inverse(this->m_window_viewport, this->m_inv_window_viewport, this->m_inv_window_viewport_of);
+	}
 
 	/**
 	 * The inverse of the window_viewport transformation.
+	 * A matrix assigned to it is taken to be the inverse of the current window_viewport().
 	 */
-	matrix4x4_type&       inv_window_viewport()       { return this->m_inv_window_viewport; }
+	matrix4x4_type& inv_window_viewport()
+	{
+	    this->m_inv_window_viewport_of = this->m_window_viewport;
+	    return this->m_inv_window_viewport;
+	}
 
         /**
 	 * Transform from World-coordinates to Canonical-coordinates.
@@ -173,12 +247,87 @@ namespace graphics
 	/**
 	 * The inverse of the projection transformation.
 	 */
-	matrix4x4_type const& inv_projection() const { return this->m_inv_projection; }
+	matrix4x4_type const& inv_projection() const
+	{
+	    return this->inverse(this->m_projection, this->m_inv_projection, this->m_inv_projection_of);
+	}
 
 	/**
 	 * The inverse of the projection transformation.
+	 * A matrix assigned to it is taken to be the inverse of the current projection().
+	 */
+	matrix4x4_type& inv_projection()
+	{
+	    this->m_inv_projection_of = this->m_projection;
+	    return this->m_inv_projection;
+	}
+
+	/**
+	 * Set a transformation. Its inverse is computed when it is needed.
+	 */
+	void set_model(matrix4x4_type const& M)            { this->m_model = M; }
+	void set_view_orientation(matrix4x4_type const& M) { this->m_view_orientation = M; }
+	void set_view_projection(matrix4x4_type const& M)  { this->m_view_projection = M; }
+	void set_window_viewport(matrix4x4_type const& M)  { this->m_window_viewport = M; }
+	void set_projection(matrix4x4_type const& M)       { this->m_projection = M; }
+
+	/**
+	 * Set a transformation and its inverse, e.g. if the inverse is known in
+	 * closed form.
 	 */
-	matrix4x4_type&       inv_projection()       { return this->m_inv_projection; }
+	void set_model(matrix4x4_type const& M, matrix4x4_type const& InvM)
+	{
+	    this->set(M, InvM, this->m_model, this->m_inv_model, this->m_inv_model_of);
+	}
+
+	void set_view_orientation(matrix4x4_type const& M, matrix4x4_type const& InvM)
+	{
+	    this->set(M, InvM, this->m_view_orientation, this->m_inv_view_orientation, this->m_inv_view_orientation_of);
+	}
+
+	void set_view_projection(matrix4x4_type const& M, matrix4x4_type const& InvM)
+	{
+	    this->set(M, InvM, this->m_view_projection, this->m_inv_view_projection, this->m_inv_view_projection_of);
+	}
+
+	void set_window_viewport(matrix4x4_type const& M, matrix4x4_type const& InvM)
+	{
+	    this->set(M, InvM, this->m_window_viewport, this->m_inv_window_viewport, this->m_inv_window_viewport_of);
+	}
+
+	void set_projection(matrix4x4_type const& M, matrix4x4_type const& InvM)
+	{
+	    this->set(M, InvM, this->m_projection, this->m_inv_projection, this->m_inv_projection_of);
+	}
+
+	/**
+	 * Transforms normals from Model-coordinates to World-coordinates.
+	 * @return The transpose of inv_model(), computed once per change of the model transformation.
+	 */
+	matrix4x4_type const& normal_matrix() const
+	{
+	    matrix4x4_type const& inv_model = this->inv_model();
+	    if (!same(this->m_normal_matrix_of, inv_model)) {
+		this->m_normal_matrix    = inv_model.T();
+		this->m_normal_matrix_of = inv_model;
+	    }
+	    return this->m_normal_matrix;
+	}
+
+	/**
+	 * Transform from Model-coordinates to Screen-coordinates.
+	 * @return The product projection() * model(), computed once per change of either.
+	 */
+	matrix4x4_type const& model_projection() const
+	{
+	    if (!same(this->m_model_projection_of_model, this->m_model) ||
+		!same(this->m_model_projection_of_projection, this->m_projection)) {
+		this->m_model_projection               = this->m_projection * this->m_model;
+		this->m_model_projection_of_model      = this->m_model;
+		this->m_model_projection_of_projection = this->m_projection;
+	    }
+	    return this->m_model_projection;
+	}
 
 	// The eye coordinate system
 	/**
@@ -346,6 +495,119 @@ namespace graphics
 	 */
 	real_type&       fall_off ()       { return this->m_fall_off; }
 
+	// The culling stage of the RenderPipeline
+	/**
+	 * Which faces are culled. Back-face culling only gives the right result
+	 * for closed meshes whose triangles are wound consistently.
+	 * @return A read-only reference to the faces which are culled, initially cull_none.
+	 */
+	cull_face_type const& cull_face() const { return this->m_cull_face; }
+
+	/**
+	 * Which faces are culled.
+	 * @return A writable reference to the faces which are culled.
+	 */
+	cull_face_type&       cull_face()       { return this->m_cull_face; }
+
+	/**
+	 * The winding of a front face in screen space.
+	 * @return A read-only reference to the winding of front faces, initially counter_clockwise.
+	 */
+	front_face_type const& front_face() const { return this->m_front_face; }
+
+	/**
+	 * The winding of a front face in screen space.
+	 * @return A writable reference to the winding of front faces.
+	 */
+	front_face_type&       front_face()       { return this->m_front_face; }
+
+	/**
+	 * Cull triangles which are entirely outside the viewport.
+	 * @return A read-only reference to the flag, initially true.
+	 */
+	bool const& viewport_culling() const { return this->m_viewport_culling; }
+
+	/**
+	 * Cull triangles which are entirely outside the viewport.
+	 * @return A writable reference to the flag.
+	 */
+	bool&       viewport_culling()       { return this->m_viewport_culling; }
+
+	/**
+	 * Cull triangles which are entirely in front of the near plane or behind
+	 * the far plane, i.e. whose depths are all outside [-1..0].
+	 * @return A read-only reference to the flag, initially false.
+	 */
+	bool const& depth_culling() const { return this->m_depth_culling; }
+
+	/**
+	 * Cull triangles which are entirely in front of the near plane or behind the far plane.
+	 * @return A writable reference to the flag.
+	 */
+	bool&       depth_culling()       { return this->m_depth_culling; }
+
+	/**
+	 * Clip triangles against the view volume, if the vertex program leaves
+	 * out the perspective division (see VertexProgram::homogeneous).
+	 * @return A read-only reference to the flag, initially true.
+	 */
+	bool const& clipping() const { return this->m_clipping; }
+
+	/**
+	 * Clip triangles against the view volume.
+	 * @return A writable reference to the flag.
+	 */
+	bool&       clipping()       { return this->m_clipping; }
+
+	/**
+	 * Test if another state has the same settings, bitwise. Every
+	 * transformation is compared together with its inverse and the matrix
+	 * the inverse belongs to, so two states which are the same also give the
+	 * same inverses. The products cached by normal_matrix() and
+	 * model_projection() are left out, since they follow from the rest.
+	 *
+	 * @param other  The state to compare with.
+	 * @return true if everything which can be read from the two states is the same.
+	 */
+	bool same_settings(GraphicsState const& other) const
+	{
+	    static matrix4x4_type GraphicsState::* const matrices[] = {
+		&GraphicsState::m_model,            &GraphicsState::m_inv_model,            &GraphicsState::m_inv_model_of,
+		&GraphicsState::m_view_orientation, &GraphicsState::m_inv_view_orientation, &GraphicsState::m_inv_view_orientation_of,
+		&GraphicsState::m_view_projection,  &GraphicsState::m_inv_view_projection,  &GraphicsState::m_inv_view_projection_of,
+		&GraphicsState::m_window_viewport,  &GraphicsState::m_inv_window_viewport,  &GraphicsState::m_inv_window_viewport_of,
+		&GraphicsState::m_projection,       &GraphicsState::m_inv_projection,       &GraphicsState::m_inv_projection_of
+	    };
+	    static vector3_type GraphicsState::* const vectors[] = {
+		&GraphicsState::m_x_eye_axis,     &GraphicsState::m_y_eye_axis,    &GraphicsState::m_z_eye_axis,
+		&GraphicsState::m_eye_position,   &GraphicsState::m_I_a,           &GraphicsState::m_I_p,
+		&GraphicsState::m_light_position, &GraphicsState::m_ambient_color, &GraphicsState::m_diffuse_color,
+		&GraphicsState::m_specular_color
+	    };
+	    static real_type GraphicsState::* const reals[] = {
+		&GraphicsState::m_ambient_intensity,  &GraphicsState::m_diffuse_intensity,
+		&GraphicsState::m_specular_intensity, &GraphicsState::m_fall_off
+	    };
+
+	    for (unsigned int i = 0; i < sizeof(matrices) / sizeof(matrices[0]); ++i) {
+		if (!same(this->*matrices[i], other.*matrices[i]))
+		    return false;
+	    }
+	    for (unsigned int i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+		if (std::memcmp(&(this->*vectors[i])[1], &(other.*vectors[i])[1], 3 * sizeof(real_type)) != 0)
+		    return false;
+	    }
+	    for (unsigned int i = 0; i < sizeof(reals) / sizeof(reals[0]); ++i) {
+		if (std::memcmp(&(this->*reals[i]), &(other.*reals[i]), sizeof(real_type)) != 0)
+		    return false;
+	    }
+	    return (this->m_cull_face        == other.m_cull_face)        &&
+		   (this->m_front_face       == other.m_front_face)       &&
+		   (this->m_viewport_culling == other.m_viewport_culling) &&
+		   (this->m_depth_culling    == other.m_depth_culling)    &&
+		   (this->m_clipping         == other.m_clipping);
+	}
+
 
 
 	// Should be changed from < to >= by kaiip 06.12.2008 - 00:44
@@ -368,27 +630,75 @@ namespace graphics
 #endif
 
     protected:
+	/**
+	 * The inverse of a transformation, computed if InvM does not belong to M.
+	 * Affine transformations are inverted in closed form from their upper
+	 * left 3 x 3 block, and all others by their cofactors.
+	 *
+	 * @param M       The transformation.
+	 * @param InvM    Its inverse.
+	 * @param InvM_of The matrix which InvM is the inverse of.
+	 * @return InvM.
+	 */
+	static matrix4x4_type const& inverse(matrix4x4_type const& M, matrix4x4_type& InvM, matrix4x4_type& InvM_of)
+	{
+	    if (!same(InvM_of, M)) {
+		bool affine = (M[4][1] == 0) && (M[4][2] == 0) && (M[4][3] == 0) && (M[4][4] == 1);
+		InvM    = affine ? AffineInverse(M) : CofactorInverse(M);
+		InvM_of = M;
+	    }
+	    return InvM;
+	}
+
+	/**
+	 * Test if two matrices are bitwise the same, which is all the cached
+	 * matrices need to know, and much faster than comparing the entries.
+	 */
+	static bool same(matrix4x4_type const& A, matrix4x4_type const& B)
+	{
+	    return std::memcmp(&A, &B, sizeof(matrix4x4_type)) == 0;
+	}
+
+	static void set(matrix4x4_type const& M, matrix4x4_type const& InvM,
+			matrix4x4_type& Dest, matrix4x4_type& InvDest, matrix4x4_type& InvDest_of)
+	{
+	    Dest       = M;
+	    InvDest    = InvM;
+	    InvDest_of = M;
+	}
 
 	///  Model to world transformation matrix.
-	matrix4x4_type m_model;
-	matrix4x4_type m_inv_model;
+	matrix4x4_type         m_model;
+	mutable matrix4x4_type m_inv_model;
+	mutable matrix4x4_type m_inv_model_of;
 	
 
 	/// World to eye space transformation matrix (view-orientation).
-	matrix4x4_type m_view_orientation;
-	matrix4x4_type m_inv_view_orientation;
+	matrix4x4_type         m_view_orientation;
+	mutable matrix4x4_type m_inv_view_orientation;
+	mutable matrix4x4_type m_inv_view_orientation_of;
 
 	/// Eye to Canonical view-volume transformation matrix.
-	matrix4x4_type m_view_projection;
-	matrix4x4_type m_inv_view_projection;
+	matrix4x4_type         m_view_projection;
+	mutable matrix4x4_type m_inv_view_projection;
+	mutable matrix4x4_type m_inv_view_projection_of;
 
         /// Canonical volume to screen transformation matrix.
-	matrix4x4_type m_window_viewport;
-	matrix4x4_type m_inv_window_viewport;
+	matrix4x4_type         m_window_viewport;
+	mutable matrix4x4_type m_inv_window_viewport;
+	mutable matrix4x4_type m_inv_window_viewport_of;
 
 	/// World to screen space transformation matrix (projection) all the way.
-	matrix4x4_type m_projection;
-	matrix4x4_type m_inv_projection;
+	matrix4x4_type         m_projection;
+	mutable matrix4x4_type m_inv_projection;
+	mutable matrix4x4_type m_inv_projection_of;
+
+	/// The normal matrix and the model to screen transformation, see normal_matrix() and model_projection().
+	mutable matrix4x4_type m_normal_matrix;
+	mutable matrix4x4_type m_normal_matrix_of;
+	mutable matrix4x4_type m_model_projection;
+	mutable matrix4x4_type m_model_projection_of_model;
+	mutable matrix4x4_type m_model_projection_of_projection;
 
 	
 	/// x-axis of the eye coordinate system
@@ -437,6 +747,24 @@ namespace graphics
 
 	/// Specular exponent n.
 	real_type       m_fall_off;
+
+	/**
+	 * The parameters of the culling stage
+	 */
+	/// The faces which are culled.
+	cull_face_type  m_cull_face;
+
+	/// The winding of front faces.
+	front_face_type m_front_face;
+
+	/// Cull triangles outside the viewport.
+	bool            m_viewport_culling;
+
+	/// Cull triangles outside the depth range.
+	bool            m_depth_culling;
+
+	/// Clip triangles against the view volume.
+	bool            m_clipping;
     };
 
 }// end namespace graphics
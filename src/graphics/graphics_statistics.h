@@ -0,0 +1,197 @@
+#ifndef GRAPHICS_STATISTICS_H
+#define GRAPHICS_STATISTICS_H
+//
+// Graphics Framework.
+// Copyright (C) 2011 Department of Computer Science, University of Copenhagen
+//
+
+#include <iostream>
+#include <iomanip>
+
+// The stage timers read the time stamp counter, and cost a little time on
+// every span of fragments. They are only compiled in if GRAPHICS_STATISTICS_TIMERS
+// is defined, otherwise GRAPHICS_STAGE_TIMER expands to nothing.
+#ifdef GRAPHICS_STATISTICS_TIMERS
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  elif defined(__i386__) || defined(__x86_64__)
+#    include <x86intrin.h>
+#  else
+#    include <chrono>
+#  endif
+#endif
+
+namespace graphics
+{
+
+    /**
+     * Pipeline Statistics.
+     * Counts the work done by each stage of the RenderPipeline since the last
+     * reset, which the RenderPipeline does whenever it is cleared, such that
+     * the statistics cover one frame.
+     *
+     * A triangle which is submitted is either degenerate, culled, or handed to
+     * the rasterizer. A triangle which is clipped is cut into a fan of smaller
+     * triangles, which are tested and counted on their own as degenerate or
+     * culled, but not as submitted. The fragments generated by the rasterizer include those
+     * outside the scissor rectangle, e.g. outside the tile in binning mode, so
+     * passed and failed fragments may add up to fewer than generated ones.
+     */
+    struct PipelineStatistics
+    {
+	/// The stages which are timed if GRAPHICS_STATISTICS_TIMERS is defined.
+	enum stage_type {
+	    vertex_stage = 0,   ///< Running the vertex program.
+	    setup_stage,        ///< Culling, binning, and initializing the rasterizer.
+	    raster_stage,       ///< Generating fragments and running the z-test.
+	    shade_stage,        ///< Interpolating the attributes and running the fragment program.
+	    stage_count
+	};
+
+	long long vertices_shaded;        ///< Vertices run through the vertex program.
+	long long vertex_cache_hits;      ///< Vertices of draw_triangle found in the post-transform cache.
+	long long triangles_submitted;    ///< Triangles handed to the pipeline.
+	long long triangles_culled;       ///< Triangles skipped before they reached the rasterizer.
+	long long triangles_degenerate;   ///< Triangles with no area in screen space.
+	long long triangles_clipped;      ///< Triangles which were cut by the view volume.
+	long long fragments_generated;    ///< Fragments produced by the rasterizer.
+	long long fragments_passed;       ///< Fragments which passed the z-test.
+	long long fragments_failed;       ///< Fragments which failed the z-test.
+	long long fragments_shaded;       ///< Fragments run through the fragment program.
+
+	/// The time spent in each stage, in cycles of the time stamp counter.
+	/// In binning mode the time of all worker threads is added up.
+	unsigned long long cycles[stage_count];
+
+	PipelineStatistics()
+	{
+	    this->reset();
+	}
+
+	/**
+	 * Set all counters and timers to zero.
+	 */
+	void reset()
+	{
+	    this->vertices_shaded      = 0;
+	    this->vertex_cache_hits    = 0;
+	    this->triangles_submitted  = 0;
+	    this->triangles_culled     = 0;
+	    this->triangles_degenerate = 0;
+	    this->triangles_clipped    = 0;
+	    this->fragments_generated  = 0;
+	    this->fragments_passed     = 0;
+	    this->fragments_failed     = 0;
+	    this->fragments_shaded     = 0;
+	    for (int i = 0; i < stage_count; ++i)
+		this->cycles[i] = 0;
+	}
+
+	/**
+	 * Add the counters and timers of another PipelineStatistics to these.
+	 */
+	PipelineStatistics& operator+=(PipelineStatistics const& other)
+	{
+	    this->vertices_shaded      += other.vertices_shaded;
+	    this->vertex_cache_hits    += other.vertex_cache_hits;
+	    this->triangles_submitted  += other.triangles_submitted;
+	    this->triangles_culled     += other.triangles_culled;
+	    this->triangles_degenerate += other.triangles_degenerate;
+	    this->triangles_clipped    += other.triangles_clipped;
+	    this->fragments_generated  += other.fragments_generated;
+	    this->fragments_passed     += other.fragments_passed;
+	    this->fragments_failed     += other.fragments_failed;
+	    this->fragments_shaded     += other.fragments_shaded;
+	    for (int i = 0; i < stage_count; ++i)
+		this->cycles[i] += other.cycles[i];
+	    return *this;
+	}
+
+	/**
+	 * Test if the stage timers are compiled in.
+	 * @return true if GRAPHICS_STATISTICS_TIMERS was defined, false otherwise.
+	 */
+	static bool timers_enabled()
+	{
+#ifdef GRAPHICS_STATISTICS_TIMERS
+	    return true;
+#else
+	    return false;
+#endif
+	}
+
+	/**
+	 * Print the statistics, one counter per line.
+	 * @param stream  The stream to print to.
+	 */
+	void print(std::ostream& stream) const
+	{
+	    stream << "vertices shaded      " << std::setw(12) << this->vertices_shaded      << std::endl;
+	    stream << "vertex cache hits    " << std::setw(12) << this->vertex_cache_hits    << std::endl;
+	    stream << "triangles submitted  " << std::setw(12) << this->triangles_submitted  << std::endl;
+	    stream << "triangles culled     " << std::setw(12) << this->triangles_culled     << std::endl;
+	    stream << "triangles degenerate " << std::setw(12) << this->triangles_degenerate << std::endl;
+	    stream << "triangles clipped    " << std::setw(12) << this->triangles_clipped    << std::endl;
+	    stream << "fragments generated  " << std::setw(12) << this->fragments_generated  << std::endl;
+	    stream << "fragments passed     " << std::setw(12) << this->fragments_passed     << std::endl;
+	    stream << "fragments failed     " << std::setw(12) << this->fragments_failed     << std::endl;
+	    stream << "fragments shaded     " << std::setw(12) << this->fragments_shaded     << std::endl;
+	    if (timers_enabled()) {
+		static char const* names[stage_count] = { "vertex", "setup ", "raster", "shade " };
+		for (int i = 0; i < stage_count; ++i)
+		    stream << names[i] << " cycles        " << std::setw(12) << this->cycles[i] << std::endl;
+	    }
+	}
+    };
+
+
+#ifdef GRAPHICS_STATISTICS_TIMERS
+
+    /**
+     * Read the Time Stamp Counter.
+     * Falls back to a nanosecond clock on processors without one.
+     */
+    inline unsigned long long cycle_count()
+    {
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /**
+     * Stage Timer.
+     * Adds the cycles from its construction to its destruction to a counter.
+     */
+    class StageTimer
+    {
+    public:
+	StageTimer(unsigned long long& counter) : m_counter(counter), m_start(cycle_count())
+	{}
+
+	~StageTimer()
+	{
+	    this->m_counter += cycle_count() - this->m_start;
+	}
+
+    private:
+	unsigned long long& m_counter;
+	unsigned long long  m_start;
+    };
+
+#  define GRAPHICS_STAGE_TIMER(statistics, stage) \
+	graphics::StageTimer stage_timer_(statistics.cycles[graphics::PipelineStatistics::stage])
+
+#else
+
+#  define GRAPHICS_STAGE_TIMER(statistics, stage)
+
+// GRAPHICS_STATISTICS_TIMERS
+#endif
+
+}// end namespace graphics
+
+// GRAPHICS_STATISTICS_H
+#endif
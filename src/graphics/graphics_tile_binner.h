@@ -0,0 +1,244 @@
+#ifndef GRAPHICS_TILE_BINNER_H
+#define GRAPHICS_TILE_BINNER_H
+//
+// Graphics Framework.
+// Copyright (C) 2011 Department of Computer Science, University of Copenhagen
+//
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "graphics_rasterizer.h"
+#include "graphics_fragment_program.h"
+
+namespace graphics
+{
+    /**
+     * Tile Binner.
+     * The screen is divided into square tiles, and every triangle which has
+     * been processed by the vertex program is put into the bin of each tile
+     * its bounding box overlaps. Afterwards the tiles can be rasterized
+     * independently of each other, because no two tiles share a pixel.
+     *
+     * The triangles are kept in the order they were submitted, such that the
+     * result of the z-test is the same as if they were drawn one at a time.
+     */
+    template< typename math_types >
+    class TileBinner
+    {
+    public:
+	typedef typename math_types::real_type     real_type;
+	typedef typename math_types::vector3_type  vector3_type;
+
+	typedef Rasterizer<math_types>             rasterizer_type;
+	typedef FragmentProgram<math_types>        fragment_program_type;
+
+	/**
+	 * A triangle which has been transformed into screen-space together
+	 * with the rasterizer and fragment program it was submitted with.
+	 */
+	struct triangle_type
+	{
+	    vector3_type vertex[3];
+	    vector3_type normal[3];
+	    vector3_type worldpoint[3];
+	    vector3_type color[3];
+
+	    rasterizer_type*       rasterizer;
+	    fragment_program_type* fragment_program;
+	};
+
+    public:
+	/**
+	 * Creates an empty TileBinner with tiles of size 64 x 64.
+	 */
+	TileBinner() : m_tile_size(64), m_width(0), m_height(0), m_columns(0), m_rows(0)
+	{}
+
+	virtual ~TileBinner()
+	{}
+
+	/**
+	 * Set Resolution.
+	 * Any triangles which have been binned are discarded.
+	 *
+	 * @param width      The number of pixels in a row.
+	 * @param height     The number of pixels in a column.
+	 * @param tile_size  The width and height of a tile in pixels. Must be positive
+	 *                   otherwise an exception is thrown.
+	 */
+	void set_resolution(int width, int height, int tile_size)
+	{
+	    if (tile_size <= 0)
+		throw std::invalid_argument("TileBinner::set_resolution(): tile size must be positive");
+
+	    this->m_tile_size = tile_size;
+	    this->m_width     = width;
+	    this->m_height    = height;
+	    this->m_columns   = (width  + tile_size - 1) / tile_size;
+	    this->m_rows      = (height + tile_size - 1) / tile_size;
+
+	    this->m_bins.clear();
+	    this->m_bins.resize(this->m_columns * this->m_rows);
+	    this->m_triangles.clear();
+	    this->m_rasterizers.clear();
+	}
+
+	/**
+	 * The width and height of a tile.
+	 * @return The size of a tile in pixels.
+	 */
+	int tile_size() const
+	{
+	    return this->m_tile_size;
+	}
+
+	/**
+	 * The number of tiles.
+	 * @return The total number of tiles covering the screen.
+	 */
+	int tile_count() const
+	{
+	    return this->m_columns * this->m_rows;
+	}
+
+	/**
+	 * Tile Bounds.
+	 * Computes the pixels which are covered by a tile, the bounds are inclusive.
+	 *
+	 * @param tile   The index of the tile.
+	 * @param x_min  The smallest x-coordinate inside the tile.
+	 * @param y_min  The smallest y-coordinate inside the tile.
+	 * @param x_max  The largest x-coordinate inside the tile.
+	 * @param y_max  The largest y-coordinate inside the tile.
+	 */
+	void tile_bounds(int tile, int& x_min, int& y_min, int& x_max, int& y_max) const
+	{
+	    int column = tile % this->m_columns;
+	    int row    = tile / this->m_columns;
+
+	    x_min = column * this->m_tile_size;
+	    y_min = row    * this->m_tile_size;
+	    x_max = std::min(x_min + this->m_tile_size, this->m_width)  - 1;
+	    y_max = std::min(y_min + this->m_tile_size, this->m_height) - 1;
+	}
+
+	/**
+	 * Test if any triangles are waiting to be rasterized.
+	 * @return true if no triangles have been binned, false otherwise.
+	 */
+	bool empty() const
+	{
+	    return this->m_triangles.empty();
+	}
+
+	/**
+	 * Bin a Triangle.
+	 * The triangle is stored and put into the bin of every tile which is
+	 * overlapped by its bounding box. Triangles which are entirely outside
+	 * the screen are dropped.
+	 *
+	 * @param triangle  A triangle in screen-space.
+	 */
+	void bin(triangle_type const& triangle)
+	{
+	    real_type x_low  = std::min(std::min(triangle.vertex[0][1], triangle.vertex[1][1]), triangle.vertex[2][1]);
+	    real_type x_high = std::max(std::max(triangle.vertex[0][1], triangle.vertex[1][1]), triangle.vertex[2][1]);
+	    real_type y_low  = std::min(std::min(triangle.vertex[0][2], triangle.vertex[1][2]), triangle.vertex[2][2]);
+	    real_type y_high = std::max(std::max(triangle.vertex[0][2], triangle.vertex[1][2]), triangle.vertex[2][2]);
+
+	    //--- The rasterizers round the vertices, so a pixel of slack is added.
+	    //--- The negated tests also drop triangles with NaN coordinates.
+	    if (!(x_high >= -1) || !(y_high >= -1)) return;
+	    if (!(x_low <= this->m_width) || !(y_low <= this->m_height)) return;
+
+	    int x_min = std::max(static_cast<int>(std::floor(std::max(x_low, real_type(0)))) - 1, 0);
+	    int y_min = std::max(static_cast<int>(std::floor(std::max(y_low, real_type(0)))) - 1, 0);
+	    int x_max = std::min(static_cast<int>(std::ceil(std::min(x_high, real_type(this->m_width))))  + 1,
+				 this->m_width  - 1);
+	    int y_max = std::min(static_cast<int>(std::ceil(std::min(y_high, real_type(this->m_height)))) + 1,
+				 this->m_height - 1);
+
+	    int index = static_cast<int>(this->m_triangles.size());
+	    this->m_triangles.push_back(triangle);
+
+	    for (int row = y_min / this->m_tile_size; row <= y_max / this->m_tile_size; ++row) {
+		for (int column = x_min / this->m_tile_size; column <= x_max / this->m_tile_size; ++column) {
+		    this->m_bins[row * this->m_columns + column].push_back(index);
+		}
+	    }
+
+	    if (std::find(this->m_rasterizers.begin(), this->m_rasterizers.end(), triangle.rasterizer)
+		== this->m_rasterizers.end())
+		this->m_rasterizers.push_back(triangle.rasterizer);
+	}
+
+	/**
+	 * The triangles overlapping a tile.
+	 * @param tile  The index of the tile.
+	 * @return The indices of the triangles in the order they were binned.
+	 */
+	std::vector<int> const& triangles_in(int tile) const
+	{
+	    return this->m_bins[tile];
+	}
+
+	/**
+	 * Get a binned Triangle.
+	 * @param index  The index of the triangle.
+	 * @return A read-only reference to the triangle.
+	 */
+	triangle_type const& triangle(int index) const
+	{
+	    return this->m_triangles[index];
+	}
+
+	/**
+	 * The Rasterizers in use.
+	 * @return The distinct rasterizers which the binned triangles were submitted with.
+	 */
+	std::vector<rasterizer_type*> const& rasterizers() const
+	{
+	    return this->m_rasterizers;
+	}
+
+	/**
+	 * Discard all binned triangles. The memory of the bins is kept for the next frame.
+	 */
+	void reset()
+	{
+	    for (typename std::vector<std::vector<int> >::iterator bin = this->m_bins.begin();
+		 bin != this->m_bins.end(); ++bin)
+		bin->clear();
+	    this->m_triangles.clear();
+	    this->m_rasterizers.clear();
+	}
+
+    protected:
+	/// The width and height of a tile.
+	int m_tile_size;
+
+	/// The size of the screen.
+	int m_width;
+	int m_height;
+
+	/// The number of tiles in the x- and y-directions.
+	int m_columns;
+	int m_rows;
+
+	/// All the triangles which have been binned.
+	std::vector<triangle_type>      m_triangles;
+
+	/// For each tile the indices of the triangles which overlap it.
+	std::vector<std::vector<int> >  m_bins;
+
+	/// The distinct rasterizers referenced by the binned triangles.
+	std::vector<rasterizer_type*>   m_rasterizers;
+    };
+
+}// end namespace graphics
+
+// GRAPHICS_TILE_BINNER_H
+#endif
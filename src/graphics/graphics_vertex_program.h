@@ -14,10 +14,28 @@ namespace graphics
     {
     public:
 	typedef typename math_types::vector3_type     vector3_type;
+	typedef typename math_types::vector4_type     vector4_type;
+	typedef typename math_types::matrix4x4_type   matrix4x4_type;
 	typedef typename  math_types::real_type       real_type;
 	typedef GraphicsState<math_types>             graphics_state_type;
 
     public:
+	/**
+	 * Begin a batch of vertices which are transformed alike.
+	 * The render pipeline calls it at the start of every draw call, before
+	 * run or run_homogeneous, with the transformations of the state already
+	 * multiplied together, so a vertex program can keep them instead of
+	 * computing them for every vertex. The default implementation ignores them.
+	 *
+	 * @param state             The state of the draw call.
+	 * @param model_projection  state.model_projection(), i.e. projection() * model().
+	 * @param normal_matrix     state.normal_matrix(), i.e. the transpose of inv_model().
+	 */
+	virtual void begin_batch( graphics_state_type const& state,
+				  matrix4x4_type const& model_projection,
+				  matrix4x4_type const& normal_matrix )
+	{}
+
 	virtual void run( graphics_state_type const& state,
 			  vector3_type const& in_vertex,
 			  vector3_type const& in_color,
@@ -32,6 +50,38 @@ namespace graphics
 			  vector3_type& out_normal,
 			  vector3_type& out_color ) = 0;
 
+	/**
+	 * Test if the vertex program has its own implementation of run_homogeneous.
+	 * The render pipeline only clips triangles against the view volume if it has.
+	 *
+	 * @return true if run_homogeneous leaves out the division by w.
+	 */
+	virtual bool homogeneous() const
+	{
+	    return false;
+	}
+
+	/**
+	 * Run the vertex program without the perspective division.
+	 * The output vertex is in homogeneous screen coordinates, i.e. it is the
+	 * vertex computed by run before it is divided by its fourth coordinate.
+	 * The default implementation runs run, and sets the fourth coordinate to 1.
+	 */
+	virtual void run_homogeneous( graphics_state_type const& state,
+				      vector3_type const& in_vertex,
+				      vector3_type const& in_normal,
+				      vector3_type const& in_color,
+				      vector4_type& out_vertex,
+				      vector3_type& out_normal,
+				      vector3_type& out_color )
+	{
+	    vector3_type out_point;
+	    this->run(state, in_vertex, in_normal, in_color, out_point, out_normal, out_color);
+	    for (int i = 1; i <= 3; ++i)
+		out_vertex[i] = out_point[i];
+	    out_vertex[4] = 1;
+	}
+
     };
 
 }// end namespace graphics
@@ -11,8 +11,10 @@
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <limits>
 
 #include "graphics_state.h"
+#include "graphics_rasterizer.h"
 
 
 namespace graphics
@@ -24,9 +26,25 @@ namespace graphics
      * Each row of the 2D array has ``width'' values and each column has ''height'' values. 
      * Notice that the (0,0) entry of the array corresponds to the lower-left corner
      * on the ``screen'' (width-1,height-1) location corresponds to the upper right corner.
+     *
+     * The z-buffer also keeps a pyramid of depth bounds. Every entry of the
+     * lowest level holds the smallest and the largest z-value of a block of
+     * pyramid_size x pyramid_size pixels, and every entry of the next level
+     * holds the bounds of pyramid_size x pyramid_size entries of the level
+     * below, and so on up to a single entry. The bounds are widened when a
+     * z-value is written, and if the old z-value was one of the bounds the
+     * entry is marked dirty and recomputed the next time it is needed. This
+     * way the bounds always contain every z-value, and the pyramid can tell
+     * if a whole triangle or block of fragments would fail the z-test.
+     *
+     * Clearing is lazy. clear() only sets the bounds of the pyramid and marks
+     * every block of the lowest level as cleared. Reading a z-value of a cleared
+     * block gives the clear value, and a cleared block is filled just before
+     * its first z-value is written, so the blocks which are never drawn into
+     * are never touched at all.
      */
     template< typename math_types >
-    class ZBuffer
+    class ZBuffer : public OcclusionQuery<math_types>
     {
     public:
 	/**
@@ -39,14 +57,41 @@ namespace graphics
 	 */
 	typedef typename math_types::vector3_type vector3_type;
 
+	/**
+	 * The number of entries in each direction, which an entry of the
+	 * depth pyramid covers in the level below.
+	 */
+	enum { pyramid_size = 8 };
+
     protected:
 
+	/**
+	 * A level of the depth pyramid.
+	 */
+	struct level_type
+	{
+	    int                columns;  ///< The number of entries in a row.
+	    int                rows;     ///< The number of entries in a column.
+	    std::vector<float> min;      ///< The lower bounds of the z-values.
+	    std::vector<float> max;      ///< The upper bounds of the z-values.
+	    std::vector<char>  dirty;    ///< Non-zero if the bounds may be too wide.
+	};
+
 	std::vector<float> m_values;     ///< The Z-values. A row format is adopted.
 	int                m_width;      ///< The number of pixels in a row.
 	int                m_height;     ///< The number of pixels in a column.
 
+	std::vector<char>  m_cleared;     ///< Non-zero for every block of the lowest level which is cleared but not yet filled.
+	real_type          m_clear_value; ///< The value of the last clear.
+
+	mutable std::vector<level_type> m_levels;  ///< The depth pyramid, the finest level first.
+	bool                            m_deferred; ///< If true, only the finest level is kept up to date.
+
     public:
 
+	ZBuffer() : m_width(0), m_height(0), m_clear_value(0), m_deferred(false)
+	{}
+
 
 	/**
 	 * Clear Z Buffer.
@@ -63,14 +108,21 @@ namespace graphics
 	    if (clear_value < 0 || clear_value > 1) {
 		throw std::invalid_argument("graphics_zbuffer::clear(real_type&): clear value must be in [0..1]");
 	    }
-	    std::fill(m_values.begin(), m_values.end(), clear_value);
 #else
 	    // Changed by kaiip 06.12.2008 - 01:44
 	    if (clear_value > 0 || clear_value < -1) {
 		throw std::invalid_argument("graphics_zbuffer::clear(real_type&): clear value must be in [-1..0]");
 	    }
-	    std::fill(m_values.begin(), m_values.end(), clear_value);
 #endif
+	    this->m_clear_value = clear_value;
+	    std::fill(this->m_cleared.begin(), this->m_cleared.end(), 1);
+
+	    for (typename std::vector<level_type>::iterator level = this->m_levels.begin();
+		 level != this->m_levels.end(); ++level) {
+		std::fill(level->min.begin(), level->min.end(), clear_value);
+		std::fill(level->max.begin(), level->max.end(), clear_value);
+		std::fill(level->dirty.begin(), level->dirty.end(), 0);
+	    }
 	}
 
 	/**
@@ -89,6 +141,25 @@ namespace graphics
 	    m_values.resize(width*height);
 	    m_width  = width;
 	    m_height = height;
+
+	    //--- The bounds are unknown until they are computed from the z-values
+	    this->m_levels.clear();
+	    int columns = width;
+	    int rows    = height;
+	    do {
+		columns = (columns + pyramid_size - 1) / pyramid_size;
+		rows    = (rows    + pyramid_size - 1) / pyramid_size;
+
+		level_type level;
+		level.columns = columns;
+		level.rows    = rows;
+		level.min.resize(columns * rows);
+		level.max.resize(columns * rows);
+		level.dirty.resize(columns * rows, 1);
+		this->m_levels.push_back(level);
+	    } while ((columns > 1) || (rows > 1));
+
+	    this->m_cleared.assign(this->m_levels[0].columns * this->m_levels[0].rows, 0);
 	}
 
 	/**
@@ -109,19 +180,11 @@ namespace graphics
 		throw std::invalid_argument("graphics_zbuffer::write: depth must be within [0...1]");
 #else
 
-#if 1
-	    // Comment this out to clamp the z-value. kaiip 23.03.2010-20:46
-	    if (local_z_value > 0 || local_z_value < -1) {
-		std::ostringstream errormessage;
-		errormessage << "graphics_zbuffer::write: the depth "
-			     << z_value << " must be within [-1...0]" << std::ends;
-		//throw std::invalid_argument(errormessage.str());
-		std::cout << errormessage.str() << std::endl;
-	    }
-
+	    //--- The render pipeline clips against the view volume, so a depth
+	    //--- outside [-1...0] is a rounding error, or comes from a vertex
+	    //--- program which does not clip. It is clamped without a message.
 	    if (local_z_value > 0)  local_z_value = 0;
 	    if (local_z_value < -1) local_z_value = -1;
-#endif
 
 #endif
 	    //--- Simple minded clipping against framebuffer
@@ -134,12 +197,20 @@ namespace graphics
 	    if(y >= m_height)
 		return;
 
+	    //--- A block which is still cleared is filled before it is written
+	    int block = (y / pyramid_size) * this->m_levels[0].columns + x / pyramid_size;
+	    if (this->m_cleared[block])
+		this->fill_block(block);
+
 	    //--- Determine memory location of the pixel that should be written
 	    int offset = (y * m_width + x);
 	    
 	    //--- Wtite the pixel to the frame buffer
 	    //m_values[offset]   = z_value;
+	    float old_value    = m_values[offset];
 	    m_values[offset]   = local_z_value;
+
+	    this->update_pyramid(x, y, old_value, m_values[offset]);
 	}
 
 
@@ -164,10 +235,200 @@ namespace graphics
 	    if (y >= m_height)
 		return off_screen;
 
+	    if (this->m_cleared[(y / pyramid_size) * this->m_levels[0].columns + x / pyramid_size])
+		return this->m_clear_value;
+
 	    //--- Determine memory location of the z-value
 	    int offset = (y * m_width + x);
 	    return m_values[offset];
 	}
+
+	/**
+	 * Hidden Query.
+	 * Tests if every fragment inside a rectangle would fail the z-test,
+	 * given the range of the depths of the fragments. Pixels outside the
+	 * z-buffer are never drawn, so they count as hidden.
+	 *
+	 * @param x_min  The smallest x-coordinate of the rectangle.
+	 * @param y_min  The smallest y-coordinate of the rectangle.
+	 * @param x_max  The largest x-coordinate of the rectangle.
+	 * @param y_max  The largest y-coordinate of the rectangle.
+	 * @param z_min  A lower bound of the depths of the fragments.
+	 * @param z_max  An upper bound of the depths of the fragments.
+	 *
+	 * @return true if no fragment can pass the z-test, false if some might.
+	 */
+	bool hidden(int x_min, int y_min, int x_max, int y_max,
+		    real_type const& z_min, real_type const& z_max) const
+	{
+	    x_min = std::max(x_min, 0);
+	    y_min = std::max(y_min, 0);
+	    x_max = std::min(x_max, this->m_width  - 1);
+	    y_max = std::min(y_max, this->m_height - 1);
+	    if ((x_min > x_max) || (y_min > y_max))
+		return true;
+
+	    //--- Start at the finest level where the rectangle overlaps a few entries,
+	    //--- the coarser levels may be shared by other threads when deferred.
+	    int level     = 0;
+	    int node_size = pyramid_size;
+	    int extent    = std::max(x_max - x_min, y_max - y_min) + 1;
+	    if (!this->m_deferred) {
+		while ((level + 1 < static_cast<int>(this->m_levels.size())) && (node_size < extent)) {
+		    ++level;
+		    node_size *= pyramid_size;
+		}
+	    }
+	    return this->hidden_in_level(level, node_size, x_min, y_min, x_max, y_max, z_min, z_max);
+	}
+
+	/**
+	 * Defer the Depth Pyramid.
+	 * While the pyramid is deferred, only the finest level is updated when a
+	 * z-value is written, and queries only use the finest level. Then several
+	 * threads may write and query the z-buffer at the same time, as long as
+	 * they stay inside different blocks of pyramid_size x pyramid_size pixels.
+	 * When the pyramid is no longer deferred, the coarser levels are rebuilt.
+	 *
+	 * @param deferred  true to defer the pyramid, false to bring it up to date.
+	 */
+	void defer_pyramid(bool deferred)
+	{
+	    if (this->m_deferred && !deferred) {
+		for (int l = 1; l < static_cast<int>(this->m_levels.size()); ++l) {
+		    std::fill(this->m_levels[l].dirty.begin(), this->m_levels[l].dirty.end(), 1);
+		}
+	    }
+	    this->m_deferred = deferred;
+	}
+
+    protected:
+
+	/**
+	 * Fill a cleared block of the lowest level with the clear value, and
+	 * mark it as written.
+	 */
+	void fill_block(int block)
+	{
+	    int columns = this->m_levels[0].columns;
+	    int x_min = (block % columns) * pyramid_size;
+	    int y_min = (block / columns) * pyramid_size;
+	    int x_max = std::min(x_min + pyramid_size, this->m_width);
+	    int y_max = std::min(y_min + pyramid_size, this->m_height);
+	    for (int y = y_min; y < y_max; ++y) {
+		std::fill(&this->m_values[y * this->m_width + x_min],
+			  &this->m_values[0] + y * this->m_width + x_max, this->m_clear_value);
+	    }
+	    this->m_cleared[block] = 0;
+	}
+
+	/**
+	 * Widens the bounds of the pyramid entries covering a pixel, after its
+	 * z-value has been written.
+	 */
+	void update_pyramid(int x, int y, float old_value, float new_value)
+	{
+	    if (new_value == old_value)
+		return;
+
+	    int column = x / pyramid_size;
+	    int row    = y / pyramid_size;
+	    for (int l = 0; l < static_cast<int>(this->m_levels.size()); ++l) {
+		level_type& level = this->m_levels[l];
+		int index = row * level.columns + column;
+
+		//--- If the old value was a bound, the bound may now be too wide
+		if ((old_value == level.min[index]) || (old_value == level.max[index]))
+		    level.dirty[index] = 1;
+		if (new_value < level.min[index]) level.min[index] = new_value;
+		if (new_value > level.max[index]) level.max[index] = new_value;
+
+		if (this->m_deferred)
+		    break;
+		column /= pyramid_size;
+		row    /= pyramid_size;
+	    }
+	}
+
+	/**
+	 * Recomputes the bounds of a dirty pyramid entry from the level below.
+	 */
+	void refresh(int l, int index) const
+	{
+	    level_type& level = this->m_levels[l];
+	    if (!level.dirty[index])
+		return;
+
+	    int column = index % level.columns;
+	    int row    = index / level.columns;
+	    float min_value = std::numeric_limits<float>::max();
+	    float max_value = -std::numeric_limits<float>::max();
+	    if ((l == 0) && this->m_cleared[index]) {
+		min_value = this->m_clear_value;
+		max_value = this->m_clear_value;
+	    }
+	    else if (l == 0) {
+		int x_max = std::min((column + 1) * pyramid_size, this->m_width);
+		int y_max = std::min((row    + 1) * pyramid_size, this->m_height);
+		for (int y = row * pyramid_size; y < y_max; ++y) {
+		    for (int x = column * pyramid_size; x < x_max; ++x) {
+			float value = this->m_values[y * this->m_width + x];
+			min_value = std::min(min_value, value);
+			max_value = std::max(max_value, value);
+		    }
+		}
+	    }
+	    else {
+		level_type const& below = this->m_levels[l - 1];
+		int column_max = std::min((column + 1) * pyramid_size, below.columns);
+		int row_max    = std::min((row    + 1) * pyramid_size, below.rows);
+		for (int r = row * pyramid_size; r < row_max; ++r) {
+		    for (int c = column * pyramid_size; c < column_max; ++c) {
+			this->refresh(l - 1, r * below.columns + c);
+			min_value = std::min(min_value, below.min[r * below.columns + c]);
+			max_value = std::max(max_value, below.max[r * below.columns + c]);
+		    }
+		}
+	    }
+	    level.min[index]   = min_value;
+	    level.max[index]   = max_value;
+	    level.dirty[index] = 0;
+	}
+
+	/**
+	 * Tests the entries of a level which overlap a rectangle, and descends
+	 * into the entries which cannot decide the query by themselves.
+	 */
+	bool hidden_in_level(int l, int node_size, int x_min, int y_min, int x_max, int y_max,
+			     real_type const& z_min, real_type const& z_max) const
+	{
+	    level_type const& level = this->m_levels[l];
+	    for (int row = y_min / node_size; row <= y_max / node_size; ++row) {
+		for (int column = x_min / node_size; column <= x_max / node_size; ++column) {
+		    int index = row * level.columns + column;
+		    this->refresh(l, index);
+#ifdef KENNY_ZBUFFER
+		    bool hidden = (z_min >= level.max[index]);
+#else
+		    bool hidden = (z_max <= level.min[index]);
+#endif
+		    if (hidden)
+			continue;
+		    if (l == 0)
+			return false;
+
+		    //--- Only the part of the rectangle inside this entry is tested in the level below
+		    if (!this->hidden_in_level(l - 1, node_size / pyramid_size,
+					       std::max(x_min, column * node_size),
+					       std::max(y_min, row    * node_size),
+					       std::min(x_max, (column + 1) * node_size - 1),
+					       std::min(y_max, (row    + 1) * node_size - 1),
+					       z_min, z_max))
+			return false;
+		}
+	    }
+	    return true;
+	}
 	
     };
 
@@ -134,6 +134,9 @@ int winHeight = 768;
 #include <sstream>
 
 
+// Compiled with GRAPHICS_HEADLESS the program renders a single scene into
+// an image file instead of opening a window, see main() at the bottom.
+#ifndef GRAPHICS_HEADLESS
 //For MAC OS X
 #ifdef __APPLE__
 #  include <OpenGL/gl.h>
@@ -144,6 +147,7 @@ int winHeight = 768;
 #  include <GL/glu.h>
 #  include <GL/glut.h>
 #endif
+#endif
 
 
 #include "graphics/graphics.h"
@@ -151,6 +155,7 @@ int winHeight = 768;
 #include "solution/point_rasterizer.h"
 #include "solution/line_rasterizer.h"
 #include "solution/triangle_rasterizer.h"
+#include "solution/halfspace_rasterizer.h"
 #include "solution/math_types.h"
 #include "solution/camera.h"
 #include "solution/vertex_program.h"
@@ -180,7 +185,7 @@ using namespace graphics;
 #define ORIGINALMENU         0
 
 #if (ORIGINALMENU == 0)
-typedef enum { cmSubdivision = 1, cmForwardDifferencing = 2 } CurveModels;
+typedef enum { cmSubdivision = 1, cmForwardDifferencing = 2, cmAdaptive = 3 } CurveModels;
 // for some reason cannot be even!? check limits in ForwardDiffBezierPatch...
 int                    forward_diff_steps = 3;
 CurveModels            cur_curve_model    = cmForwardDifferencing;
@@ -195,6 +200,10 @@ MyPhongFragmentProgram<MyMathTypes>    phong_fragment_program;
 MyPointRasterizer<MyMathTypes>         point_rasterizer;
 MyLineRasterizer<MyMathTypes>          line_rasterizer;
 MyTriangleRasterizer<MyMathTypes>      triangle_rasterizer;
+MyHalfSpaceTriangleRasterizer<MyMathTypes> halfspace_rasterizer;
+
+// The triangle rasterizer used by the scenes, toggled with 'y'
+Rasterizer<MyMathTypes>*               current_triangle_rasterizer = &triangle_rasterizer;
 
 
 /*******************************************************************\
@@ -616,7 +625,7 @@ void DrawTriangles()
 {
     // TestProgram: It tests drawing of triangles.
 
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(identity_vertex_program);
     render_pipeline.load_fragment_program(identity_fragment_program);
 
@@ -892,7 +901,7 @@ int vmax = sizeof(Vertex3) / sizeof(MyMathTypes::vector3_type);
 
 void DebugTriangles()
 {
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(identity_vertex_program);
     render_pipeline.load_fragment_program(identity_fragment_program);
 
@@ -904,7 +913,7 @@ void DebugTriangles()
     YSpacing   = 1;
 
     render_pipeline.load_vertex_program(identity_vertex_program);
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 
     render_pipeline.DebugOn();
     render_pipeline.unit_length(UnitLength);
@@ -935,7 +944,7 @@ void DebugTriangles()
 
 void DrawGouraudTriangles()
 {
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(identity_vertex_program);
     render_pipeline.load_fragment_program(identity_fragment_program);
     
@@ -1020,7 +1029,7 @@ void DrawGouraudTriangles()
 
 void DrawHiddenSurfaces()
 {
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(identity_vertex_program);
     render_pipeline.load_fragment_program(identity_fragment_program);
 
@@ -1062,7 +1071,7 @@ void DrawHiddenSurfaces()
 
 void DrawPhongTriangles()
 {
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(transform_vertex_program);
     render_pipeline.load_fragment_program(phong_fragment_program);
 
@@ -1556,167 +1565,93 @@ MyMathTypes::real_type const klein_epsilon = 1.0e-4;
 
 
 #include "solution/kleinbottle.h"
+#include "solution/surfacemesh.h"
 
 KleinBottle Klein;
 
+// The tessellated parametric surfaces, which are only evaluated once
+SurfaceMeshCache<MyMathTypes> surface_meshes;
+
 /*******************************************************************\
 *                                                                   *
-*              D r a w T h e K l e i n B o t t o m ( )              *
+*                D r a w T h e K l e i n P a r t ( )                *
 *                                                                   *
 \*******************************************************************/
 
-void DrawTheKleinBottom()
+/**
+ * A part of the Klein Bottle, as a surface for SurfaceMesh::tessellate.
+ */
+struct KleinPart
+{
+    typedef MyMathTypes::vector3_type (KleinBottle::*function_type)(MyMathTypes::real_type const&,
+								    MyMathTypes::real_type const&) const;
+
+    KleinPart(function_type vertex, function_type normal) : vertex(vertex), normal(normal)
+    {}
+
+    void operator()(MyMathTypes::real_type const& u, MyMathTypes::real_type const& v,
+		    MyMathTypes::vector3_type& point, MyMathTypes::vector3_type& point_normal) const
+    {
+	point        = (Klein.*vertex)(u, v);
+	point_normal = (Klein.*normal)(u, v);
+    }
+
+    function_type vertex;
+    function_type normal;
+};
+
+void DrawTheKleinPart(std::string const& name, KleinPart const& part)
 {
     int N = 20;       // Tesselation in the u-parameter
     int M = N / 2;    // Tesselation in the v-parameter
 
-    BoundingBox<MyMathTypes> boundingbox;   // in diretory "solution"
-
-    MyMathTypes::real_type u_start = 0.0;
-    MyMathTypes::real_type delta_u = (2.0 * M_PI) / static_cast<MyMathTypes::real_type>(N);
-    MyMathTypes::real_type u_stop  = 2.0 * M_PI;
-
-    MyMathTypes::real_type v_start = 0.0;
-    MyMathTypes::real_type delta_v = M_PI / static_cast<MyMathTypes::real_type>(M);
-    MyMathTypes::real_type v_stop  = M_PI;
-
-    MyMathTypes::vector3_type v_11;   // (u, v)
-    MyMathTypes::vector3_type n_11;
-
-    MyMathTypes::vector3_type v_12;   // (u + delta_u, v)
-    MyMathTypes::vector3_type n_12;
-
-    MyMathTypes::vector3_type v_21;   // (u, v + delta_v)
-    MyMathTypes::vector3_type n_21;
-
-    MyMathTypes::vector3_type v_22;   // (u + delta_u, v + delta_v)
-    MyMathTypes::vector3_type n_22;
-
-    for (MyMathTypes::real_type u = u_start; u < u_stop; u += delta_u) {
-	for (MyMathTypes::real_type v = v_start; v < v_stop; v += delta_v) {
-	    //std::cout << std::endl;
-	    //std::cout << "v_11 = f(" << u << ", " << v << "]"  << std::endl;
-	    v_11 = Klein.BottomVertex(u, v);
-	    boundingbox.Submit(v_11);
-	    n_11 = Klein.BottomNormal(u, v);
-	    
-	    //std::cout << "v_12 = f(" << u + delta_u << ", " << v << "]" << std::endl;
-	    v_12 = Klein.BottomVertex(u + delta_u, v);
-            boundingbox.Submit(v_12);
-	    n_12 = Klein.BottomNormal(u + delta_u, v);
-
-	    //std::cout << "v_21 = f(" << u << ", " << v + delta_v << "]" << std::endl;
-	    v_21 = Klein.BottomVertex(u, v + delta_v);
-	    boundingbox.Submit(v_21);
-	    n_21 = Klein.BottomNormal(u, v + delta_v);
-
-	    //std::cout << "v_22 = f(" << u + delta_u << ", " << v + delta_v << "]" << std::endl;
-	    v_22 = Klein.BottomVertex(u + delta_u, v + delta_v);
-	    boundingbox.Submit(v_22);
-	    n_22 = Klein.BottomNormal(u + delta_u, v + delta_v);
-
-	    // Draw the triangles
-	    //render_pipeline.load_rasterizer(triangle_rasterizer);
-	    //render_pipeline.load_fragment_program(phong_fragment_program);
-	    
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_12, n_12, cwhite,
-					  v_22, n_22, cwhite);
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_22, n_22, cwhite,
-					  v_21, n_21, cwhite);
+    SurfaceMesh<MyMathTypes>::grid_type grid;
+    grid.u_start = 0.0;
+    grid.delta_u = (2.0 * M_PI) / static_cast<MyMathTypes::real_type>(N);
+    grid.u_stop  = 2.0 * M_PI;
+
+    grid.v_start = 0.0;
+    grid.delta_v = M_PI / static_cast<MyMathTypes::real_type>(M);
+    grid.v_stop  = M_PI;
+
+    // The part is only tessellated the first time it is drawn
+    SurfaceMesh<MyMathTypes> const& mesh
+	= surface_meshes.mesh(name, part, grid, std::vector<MyMathTypes::real_type>(), cwhite);
+
+    render_pipeline.draw_indexed_triangles(mesh.vertices(), mesh.normals(), mesh.colors(), mesh.indices());
 
 #if KLEINNORMALS
-	    // Draw the normals
-	    render_pipeline.load_rasterizer(line_rasterizer);
-	    render_pipeline.load_fragment_program(identity_fragment_program);
+    // Draw the normals
+    render_pipeline.load_rasterizer(line_rasterizer);
+    render_pipeline.load_fragment_program(identity_fragment_program);
 
-	    render_pipeline.draw_line(v_11, cred, v_11 + n_11, cred);
+    for (std::size_t i = 0; i < mesh.vertices().size(); ++i)
+	render_pipeline.draw_line(mesh.vertices()[i], cred, mesh.vertices()[i] + mesh.normals()[i], cred);
 #endif
-	}	
-    }
 }
 
 
 /*******************************************************************\
 *                                                                   *
-*              D r a w T h e K l e i n H a n d l e ( )              *
+*              D r a w T h e K l e i n B o t t o m ( )              *
 *                                                                   *
 \*******************************************************************/
 
-void DrawTheKleinHandle()
+void DrawTheKleinBottom()
 {
-    int N = 20;       // Tesselation in the u-parameter
-    int M = N / 2;    // Tesselation in the v-parameter
+    DrawTheKleinPart("klein-bottom", KleinPart(&KleinBottle::BottomVertex, &KleinBottle::BottomNormal));
+}
 
-    BoundingBox<MyMathTypes> boundingbox;   // in diretory "solution"
-
-    MyMathTypes::real_type u_start = 0.0;
-    MyMathTypes::real_type delta_u = (2.0 * M_PI) / static_cast<MyMathTypes::real_type>(N);
-    MyMathTypes::real_type u_stop  = 2.0 * M_PI;
-
-    MyMathTypes::real_type v_start = 0.0;
-    MyMathTypes::real_type delta_v = M_PI / static_cast<MyMathTypes::real_type>(M);
-    MyMathTypes::real_type v_stop  = M_PI;
-
-    MyMathTypes::vector3_type v_11;   // (u, v)
-    MyMathTypes::vector3_type n_11;
-
-    MyMathTypes::vector3_type v_12;   // (u + delta_u, v)
-    MyMathTypes::vector3_type n_12;
-
-    MyMathTypes::vector3_type v_21;   // (u, v + delta_v)
-    MyMathTypes::vector3_type n_21;
-
-    MyMathTypes::vector3_type v_22;   // (u + delta_u, v + delta_v)
-    MyMathTypes::vector3_type n_22;
-
-    //render_pipeline.load_vertex_program(transform_vertex_program);
-    //render_pipeline.load_fragment_program(phong_fragment_program);
-
-    for (MyMathTypes::real_type u = u_start; u < u_stop; u += delta_u) {
-	for (MyMathTypes::real_type v = v_start; v < v_stop; v += delta_v) {
-	    //std::cout << std::endl;
-	    //std::cout << "v_11 = f(" << u << ", " << v << "]"  << std::endl;
-	    v_11 = Klein.HandleVertex(u, v);
-	    boundingbox.Submit(v_11);
-	    n_11 = Klein.HandleNormal(u, v);
-	    
-	    //std::cout << "v_12 = f(" << u + delta_u << ", " << v << "]" << std::endl;
-	    v_12 = Klein.HandleVertex(u + delta_u, v);
-            boundingbox.Submit(v_12);
-	    n_12 = Klein.HandleNormal(u + delta_u, v);
-
-	    //std::cout << "v_21 = f(" << u << ", " << v + delta_v << "]" << std::endl;
-	    v_21 = Klein.HandleVertex(u, v + delta_v);
-	    boundingbox.Submit(v_21);
-	    n_21 = Klein.HandleNormal(u, v + delta_v);
-
-	    //std::cout << "v_22 = f(" << u + delta_u << ", " << v + delta_v << "]" << std::endl;
-	    v_22 = Klein.HandleVertex(u + delta_u, v + delta_v);
-	    boundingbox.Submit(v_22);
-	    n_22 = Klein.HandleNormal(u + delta_u, v + delta_v);
-
-	    // Draw the triangles
-	    //render_pipeline.load_rasterizer(triangle_rasterizer);
-	    //render_pipeline.load_fragment_program(phong_fragment_program);
-	    
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_12, n_12, cwhite,
-					  v_22, n_22, cwhite);
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_22, n_22, cwhite,
-					  v_21, n_21, cwhite);
-
-#if  KLEINNORMALS
-	    // Draw the normals
-	    render_pipeline.load_rasterizer(line_rasterizer);
-	    render_pipeline.load_fragment_program(identity_fragment_program);
 
-	    render_pipeline.draw_line(v_11, cred, v_11 + n_11, cred);
-#endif
-	}	
-    }
+/*******************************************************************\
+*                                                                   *
+*              D r a w T h e K l e i n H a n d l e ( )              *
+*                                                                   *
+\*******************************************************************/
+
+void DrawTheKleinHandle()
+{
+    DrawTheKleinPart("klein-handle", KleinPart(&KleinBottle::HandleVertex, &KleinBottle::HandleNormal));
 }
 
 
@@ -1728,75 +1663,7 @@ void DrawTheKleinHandle()
 
 void DrawTheKleinTop()
 {
-    int N = 20;       // Tesselation in the u-parameter
-    int M = N / 2;    // Tesselation in the v-parameter
-
-    BoundingBox<MyMathTypes> boundingbox;   // in diretory "solution"
-
-    MyMathTypes::real_type u_start = 0.0;
-    MyMathTypes::real_type delta_u = (2.0 * M_PI) / static_cast<MyMathTypes::real_type>(N);
-    MyMathTypes::real_type u_stop  = 2.0 * M_PI;
-
-    MyMathTypes::real_type v_start = 0.0;
-    MyMathTypes::real_type delta_v = M_PI / static_cast<MyMathTypes::real_type>(M);
-    MyMathTypes::real_type v_stop  = M_PI;
-
-    MyMathTypes::vector3_type v_11;   // (u, v)
-    MyMathTypes::vector3_type n_11;
-
-    MyMathTypes::vector3_type v_12;   // (u + delta_u, v)
-    MyMathTypes::vector3_type n_12;
-
-    MyMathTypes::vector3_type v_21;   // (u, v + delta_v)
-    MyMathTypes::vector3_type n_21;
-
-    MyMathTypes::vector3_type v_22;   // (u + delta_u, v + delta_v)
-    MyMathTypes::vector3_type n_22;
-
-    for (MyMathTypes::real_type u = u_start; u < u_stop; u += delta_u) {
-	for (MyMathTypes::real_type v = v_start; v < v_stop; v += delta_v) {
-	    //std::cout << std::endl;
-	    //std::cout << "v_11 = f(" << u << ", " << v << "]"  << std::endl;
-	    v_11 = Klein.TopVertex(u, v);
-	    boundingbox.Submit(v_11);
-	    n_11 = Klein.TopNormal(u, v);
-	    
-	    //std::cout << "v_12 = f(" << u + delta_u << ", " << v << "]" << std::endl;
-	    v_12 = Klein.TopVertex(u + delta_u, v);
-            boundingbox.Submit(v_12);
-	    n_12 = Klein.TopNormal(u + delta_u, v);
-
-	    //std::cout << "v_21 = f(" << u << ", " << v + delta_v << "]" << std::endl;
-	    v_21 = Klein.TopVertex(u, v + delta_v);
-	    boundingbox.Submit(v_21);
-	    n_21 = Klein.TopNormal(u, v + delta_v);
-
-	    //std::cout << "v_22 = f(" << u + delta_u << ", " << v + delta_v << "]" << std::endl;
-	    v_22 = Klein.TopVertex(u + delta_u, v + delta_v);
-	    boundingbox.Submit(v_22);
-	    n_22 = Klein.TopNormal(u + delta_u, v + delta_v);
-
-	    // Draw the triangles
-	    //render_pipeline.load_rasterizer(triangle_rasterizer);
-	    //render_pipeline.load_fragment_program(phong_fragment_program);
-
-	    
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_12, n_12, cwhite,
-					  v_22, n_22, cwhite);
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_22, n_22, cwhite,
-					  v_21, n_21, cwhite);
-
-#if  KLEINNORMALS
-	    // Draw the normals
-	    render_pipeline.load_rasterizer(line_rasterizer);
-	    render_pipeline.load_fragment_program(identity_fragment_program);
-
-	    render_pipeline.draw_line(v_11, cred, v_11 + n_11, cred);
-#endif
-	}	
-    }
+    DrawTheKleinPart("klein-top", KleinPart(&KleinBottle::TopVertex, &KleinBottle::TopNormal));
 }
 
 
@@ -1808,77 +1675,7 @@ void DrawTheKleinTop()
 
 void DrawTheKleinMiddle()
 {
-    int N = 20;       // Tesselation in the u-parameter
-    int M = N / 2;    // Tesselation in the v-parameter
-
-    BoundingBox<MyMathTypes> boundingbox;   // in diretory "solution"
-
-    MyMathTypes::real_type u_start = 0.0;
-    MyMathTypes::real_type delta_u = (2.0 * M_PI) / static_cast<MyMathTypes::real_type>(N);
-    MyMathTypes::real_type u_stop  = 2.0 * M_PI;
-
-    MyMathTypes::real_type v_start = 0.0;
-    MyMathTypes::real_type delta_v = M_PI / static_cast<MyMathTypes::real_type>(M);
-    MyMathTypes::real_type v_stop  = M_PI;
-
-    MyMathTypes::vector3_type v_11;   // (u, v)
-    MyMathTypes::vector3_type n_11;
-
-    MyMathTypes::vector3_type v_12;   // (u + delta_u, v)
-    MyMathTypes::vector3_type n_12;
-
-    MyMathTypes::vector3_type v_21;   // (u, v + delta_v)
-    MyMathTypes::vector3_type n_21;
-
-    MyMathTypes::vector3_type v_22;   // (u + delta_u, v + delta_v)
-    MyMathTypes::vector3_type n_22;
-
-    for (MyMathTypes::real_type u = u_start; u < u_stop; u += delta_u) {
-	for (MyMathTypes::real_type v = v_start; v < v_stop; v += delta_v) {
-	    //std::cout << std::endl;
-	    //std::cout << "v_11 = f(" << u << ", " << v << "]"  << std::endl;
-	    v_11 = Klein.MiddleVertex(u, v);
-	    boundingbox.Submit(v_11);
-	    n_11 = Klein.MiddleNormal(u, v);
-	    
-	    //std::cout << "v_12 = f(" << u + delta_u << ", " << v << "]" << std::endl;
-	    v_12 = Klein.MiddleVertex(u + delta_u, v);
-            boundingbox.Submit(v_12);
-	    n_12 = Klein.MiddleNormal(u + delta_u, v);
-
-	    //std::cout << "v_21 = f(" << u << ", " << v + delta_v << "]" << std::endl;
-	    v_21 = Klein.MiddleVertex(u, v + delta_v);
-	    boundingbox.Submit(v_21);
-	    n_21 = Klein.MiddleNormal(u, v + delta_v);
-
-	    //std::cout << "v_22 = f(" << u + delta_u << ", " << v + delta_v << "]" << std::endl;
-	    v_22 = Klein.MiddleVertex(u + delta_u, v + delta_v);
-	    boundingbox.Submit(v_22);
-	    n_22 = Klein.MiddleNormal(u + delta_u, v + delta_v);
-
-	    // Draw the triangles
-	    //render_pipeline.load_rasterizer(triangle_rasterizer);
-	    //render_pipeline.load_vertex_program(transform_vertex_program);
-	    //render_pipeline.load_fragment_program(phong_fragment_program);
-
-	    
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_12, n_12, cwhite,
-					  v_22, n_22, cwhite);
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_22, n_22, cwhite,
-					  v_21, n_21, cwhite);
-
-#if  KLEINNORMALS
-	    // Draw the normals
-	    render_pipeline.load_rasterizer(line_rasterizer);
-	    render_pipeline.load_vertex_program(transform_vertex_program);
-	    render_pipeline.load_fragment_program(identity_fragment_program);
-
-	    render_pipeline.draw_line(v_11, cred, v_11 + n_11, cred);
-#endif
-	}	
-    }
+    DrawTheKleinPart("klein-middle", KleinPart(&KleinBottle::MiddleVertex, &KleinBottle::MiddleNormal));
 }
 
 
@@ -1969,7 +1766,7 @@ void DrawKleinBottle()
 *                                                                   *
 \*******************************************************************/
 
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(transform_vertex_program);
     if(figure == 'M')
     	render_pipeline.load_fragment_program(identity_fragment_program);
@@ -1984,8 +1781,7 @@ void DrawKleinBottle()
 \*******************************************************************/
 
     MyMathTypes::real_type rotation_angle = 45.0 * M_PI /  180.0;
-    render_pipeline.state().model()     = Z_Rotate(rotation_angle);
-    render_pipeline.state().inv_model() = Inv_Z_Rotate(rotation_angle);
+    render_pipeline.state().set_model(Z_Rotate(rotation_angle), Inv_Z_Rotate(rotation_angle));
 
     DrawTheKleinBottom();
     DrawTheKleinHandle();
@@ -1995,8 +1791,7 @@ void DrawKleinBottle()
 	DrawTheKleinMiddle();
     }
 
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
 }
 
 /*******************************************************************\
@@ -2009,6 +1804,25 @@ void DrawKleinBottle()
 
 DiniSurface Dini;
 
+/**
+ * Dini's surface with the parameters a and b, as a surface for SurfaceMesh::tessellate.
+ */
+struct DiniPatch
+{
+    DiniPatch(MyMathTypes::real_type a, MyMathTypes::real_type b) : a(a), b(b)
+    {}
+
+    void operator()(MyMathTypes::real_type const& u, MyMathTypes::real_type const& v,
+		    MyMathTypes::vector3_type& point, MyMathTypes::vector3_type& normal) const
+    {
+	point  = Dini.Dini(u, v, a, b);
+	normal = Dini.DiniNormal(u, v, a, b);
+    }
+
+    MyMathTypes::real_type a;
+    MyMathTypes::real_type b;
+};
+
 /*******************************************************************\
 *                                                                   *
 *                        D r a w D i n i ( )                        *
@@ -2095,7 +1909,7 @@ void DrawDini() {
 *                                                                   *
 \*******************************************************************/
 
-	render_pipeline.load_rasterizer(triangle_rasterizer);
+	render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 	render_pipeline.load_vertex_program(transform_vertex_program);
     if(figure == 'J')
     	render_pipeline.load_fragment_program(identity_fragment_program);
@@ -2110,70 +1924,31 @@ void DrawDini() {
 \*******************************************************************/
 
 	MyMathTypes::real_type rotation_angle = 45.0 * M_PI /  180.0;
-	render_pipeline.state().model()     = Z_Rotate(rotation_angle);
-	render_pipeline.state().inv_model() = Inv_Z_Rotate(rotation_angle);
+	render_pipeline.state().set_model(Z_Rotate(rotation_angle), Inv_Z_Rotate(rotation_angle));
 
 	int N = 50; // Tesselation in the u-parameter
 	int M = N / 4; // Tesselation in the v-parameter
 
-	BoundingBox<MyMathTypes> boundingbox; // in diretory "solution"
-
-	MyMathTypes::real_type u_start = 0.0;
-	MyMathTypes::real_type delta_u = (6.0 * M_PI) / static_cast<MyMathTypes::real_type> (N);
-	MyMathTypes::real_type u_stop = 6.0 * M_PI;
-
-	MyMathTypes::real_type v_start = 0.001;
-	MyMathTypes::real_type delta_v = 2 / static_cast<MyMathTypes::real_type> (M);
-	MyMathTypes::real_type v_stop = 2;
+	SurfaceMesh<MyMathTypes>::grid_type grid;
+	grid.u_start = 0.0;
+	grid.delta_u = (6.0 * M_PI) / static_cast<MyMathTypes::real_type> (N);
+	grid.u_stop = 6.0 * M_PI;
 
-	MyMathTypes::vector3_type v_11; // (u, v)
-	MyMathTypes::vector3_type n_11;
+	grid.v_start = 0.001;
+	grid.delta_v = 2 / static_cast<MyMathTypes::real_type> (M);
+	grid.v_stop = 2;
 
-	MyMathTypes::vector3_type v_12; // (u + delta_u, v)
-	MyMathTypes::vector3_type n_12;
+	std::vector<MyMathTypes::real_type> parameters(2);
+	parameters[0] = 2.0;   // a
+	parameters[1] = 0.4;   // b
 
-	MyMathTypes::vector3_type v_21; // (u, v + delta_v)
-	MyMathTypes::vector3_type n_21;
+	// The surface is tessellated again only if a or b change
+	SurfaceMesh<MyMathTypes> const& mesh
+		= surface_meshes.mesh("dini", DiniPatch(parameters[0], parameters[1]), grid, parameters, cwhite);
 
-	MyMathTypes::vector3_type v_22; // (u + delta_u, v + delta_v)
-	MyMathTypes::vector3_type n_22;
-
-	MyMathTypes::real_type a = 2.0;
-	MyMathTypes::real_type b = 0.4;
-
-	for (MyMathTypes::real_type u = u_start; u < u_stop; u += delta_u) {
-		for (MyMathTypes::real_type v = v_start; v < v_stop; v += delta_v) {
-			//std::cout << std::endl;
-			//std::cout << "v_11 = f(" << u << ", " << v << "]"  << std::endl;
-			v_11 = Dini.Dini(u, v, a, b);
-			boundingbox.Submit(v_11);
-			n_11 = Dini.DiniNormal(u, v, a, b);
-
-			//std::cout << "v_12 = f(" << u + delta_u << ", " << v << "]" << std::endl;
-			v_12 = Dini.Dini(u + delta_u, v, a ,b);
-			boundingbox.Submit(v_12);
-			n_12 = Dini.DiniNormal(u + delta_u, v, a, b);
-
-			//std::cout << "v_21 = f(" << u << ", " << v + delta_v << "]" << std::endl;
-			v_21 = Dini.Dini(u, v + delta_v, a, b);
-			boundingbox.Submit(v_21);
-			n_21 = Dini.DiniNormal(u, v + delta_v, a, b);
-
-			//std::cout << "v_22 = f(" << u + delta_u << ", " << v + delta_v << "]" << std::endl;
-			v_22 = Dini.Dini(u + delta_u, v + delta_v, a, b);
-			boundingbox.Submit(v_22);
-			n_22 = Dini.DiniNormal(u + delta_u, v + delta_v, a, b);
-
-			// Draw the triangles
-			render_pipeline.draw_triangle(v_11, n_11, cwhite, v_12, n_12,
-					cwhite, v_22, n_22, cwhite);
-			render_pipeline.draw_triangle(v_11, n_11, cwhite, v_22, n_22,
-					cwhite, v_21, n_21, cwhite);
-		}
-	}
+	render_pipeline.draw_indexed_triangles(mesh.vertices(), mesh.normals(), mesh.colors(), mesh.indices());
 
-	render_pipeline.state().model()     = Identity();
-	render_pipeline.state().inv_model() = Identity();
+	render_pipeline.state().set_model(Identity());
 }
 
 
@@ -2194,6 +1969,25 @@ MyMathTypes::real_type const phong_epsilon = 1.0e-4;
 
 #include "solution/phongsurface.h"
 
+/**
+ * The Phong Surface scaled by a factor, as a surface for SurfaceMesh::tessellate.
+ */
+struct PhongPatch
+{
+    PhongPatch(MyMathTypes::real_type scale) : scale(scale)
+    {}
+
+    void operator()(MyMathTypes::real_type const& phi, MyMathTypes::real_type const& theta,
+		    MyMathTypes::vector3_type& point, MyMathTypes::vector3_type& normal) const
+    {
+	point  = scale * surface.Vertex(phi, theta);
+	normal = surface.Normal(phi, theta);
+    }
+
+    PhongSurface           surface;
+    MyMathTypes::real_type scale;
+};
+
 void DrawPhongSurface()
 {
 
@@ -2204,8 +1998,7 @@ void DrawPhongSurface()
 \*******************************************************************/
 
     camera.reset();
-    render_pipeline.state().model() = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
     
     MyMathTypes::vector3_type VRP(5.0, 0.0, 6.0);
     MyMathTypes::vector3_type VPN(cos(30.0 * M_PI / 180.0), 0.0, sin(30.0 * M_PI / 180.0));
@@ -2280,9 +2073,12 @@ void DrawPhongSurface()
 *                                                                   *
 \*******************************************************************/
 
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(transform_vertex_program);
-    render_pipeline.load_fragment_program(phong_fragment_program);
+    if(figure == 'X')
+	render_pipeline.load_fragment_program(identity_fragment_program);
+    else
+	render_pipeline.load_fragment_program(phong_fragment_program);
 
 
 /*******************************************************************\
@@ -2301,89 +2097,41 @@ void DrawPhongSurface()
     int M = 25;       // Tesselation in the theta-parameter
 
     MyMathTypes::real_type ScaleFactor = 14.0; // Scale the Surface
-    BoundingBox<MyMathTypes> boundingbox;   // in diretory "solution"
 
+    SurfaceMesh<MyMathTypes>::grid_type grid;
     MyMathTypes::real_type phi_start = 0.0;
     MyMathTypes::real_type phi_stop  = M_PI / 2.0;
-    MyMathTypes::real_type delta_phi = (phi_stop - phi_start) / static_cast<MyMathTypes::real_type>(N);
+    grid.u_start = phi_start;
+    grid.delta_u = (phi_stop - phi_start) / static_cast<MyMathTypes::real_type>(N);
+    grid.u_stop  = phi_stop;
 
     MyMathTypes::real_type theta_start = - M_PI;
     MyMathTypes::real_type theta_stop  =   M_PI;
-    MyMathTypes::real_type delta_theta = (theta_stop - theta_start) / static_cast<MyMathTypes::real_type>(M);
-
-    PhongSurface Phong;
-
-
-    MyMathTypes::vector3_type v_11;   // (phi, theta)
-    MyMathTypes::vector3_type n_11;
-
-    MyMathTypes::vector3_type v_12;   // (phi + delta_phi, theta)
-    MyMathTypes::vector3_type n_12;
-
-    MyMathTypes::vector3_type v_21;   // (phi, theta + delta_theta)
-    MyMathTypes::vector3_type n_21;
+    grid.v_start = theta_start;
+    grid.delta_v = (theta_stop - theta_start) / static_cast<MyMathTypes::real_type>(M);
+    grid.v_stop  = theta_stop;
 
-    MyMathTypes::vector3_type v_22;   // (phi + delta_phi, theta + delta_theta)
-    MyMathTypes::vector3_type n_22; 
+    // The surface is tessellated again only if the scale factor changes
+    SurfaceMesh<MyMathTypes> const& mesh
+	= surface_meshes.mesh("phong-surface", PhongPatch(ScaleFactor), grid,
+			      std::vector<MyMathTypes::real_type>(1, ScaleFactor), cwhite);
 
-    for (MyMathTypes::real_type phi = phi_start; phi < phi_stop; phi += delta_phi) {
-	for (MyMathTypes::real_type theta = theta_start; theta < theta_stop; theta += delta_theta) {
-	    //std::cout << std::endl;
-	    //std::cout << "v_11 = V(" << phi << ", " << theta << "]"  << std::endl;
-	    v_11 = ScaleFactor * Phong.Vertex(phi, theta);
-	    boundingbox.Submit(v_11);
-	    n_11 = Phong.Normal(phi, theta);
-	    //std::cout << "Phong.Normal(" << phi << ", " << theta << ") = [" << n_11 << "]" << std::endl;
-	    
-	    //std::cout << "v_12 = V(" << phi + delta_phi << ", " << theta << "]" << std::endl;
-	    v_12 = ScaleFactor * Phong.Vertex(phi + delta_phi, theta);
-            boundingbox.Submit(v_12);
-	    n_12 = Phong.Normal(phi + delta_phi, theta);
-
-	    //std::cout << "v_21 = V(" << phi << ", " << theta + delta_theta << "]" << std::endl;
-	    v_21 = ScaleFactor * Phong.Vertex(phi, theta + delta_theta);
-	    boundingbox.Submit(v_21);
-	    n_21 = Phong.Normal(phi, theta + delta_theta);
-
-	    //std::cout << "v_22 = V(" << phi + delta_phi << ", " << theta + delta_theta << "]" << std::endl;
-	    v_22 = ScaleFactor * Phong.Vertex(phi + delta_phi, theta + delta_theta);
-	    boundingbox.Submit(v_22);
-	    n_22 = Phong.Normal(phi + delta_phi, theta + delta_theta);
-
-	    // Draw the triangles
-	    render_pipeline.load_rasterizer(triangle_rasterizer);
-	    render_pipeline.load_vertex_program(transform_vertex_program);
-	    if(figure == 'X')
-	    	render_pipeline.load_fragment_program(identity_fragment_program);
-
-	    if(figure == 'x')
-			render_pipeline.load_fragment_program(phong_fragment_program);
-
-	    
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_12, n_12, cwhite,
-					  v_22, n_22, cwhite);
-	    render_pipeline.draw_triangle(v_11, n_11, cwhite,
-					  v_22, n_22, cwhite,
-					  v_21, n_21, cwhite);
+    render_pipeline.draw_indexed_triangles(mesh.vertices(), mesh.normals(), mesh.colors(), mesh.indices());
 
 #if PHONGNORMALS
-	    // Draw the normals
-	    render_pipeline.load_rasterizer(line_rasterizer);
-	    render_pipeline.load_vertex_program(transform_vertex_program);
-	    render_pipeline.load_fragment_program(identity_fragment_program);
+    // Draw the normals
+    render_pipeline.load_rasterizer(line_rasterizer);
+    render_pipeline.load_vertex_program(transform_vertex_program);
+    render_pipeline.load_fragment_program(identity_fragment_program);
 
-	    MyMathTypes::real_type NormalScaleFactor = 1.0;
-	    render_pipeline.draw_line(v_11, cred, v_11 + NormalScaleFactor * n_11, cred);
-	    render_pipeline.draw_line(v_12, cred, v_12 + NormalScaleFactor * n_12, cred);
-	    render_pipeline.draw_line(v_21, cred, v_21 + NormalScaleFactor * n_21, cred);
+    MyMathTypes::real_type NormalScaleFactor = 1.0;
+    for (std::size_t i = 0; i < mesh.vertices().size(); ++i)
+	render_pipeline.draw_line(mesh.vertices()[i], cred,
+				  mesh.vertices()[i] + NormalScaleFactor * mesh.normals()[i], cred);
 #endif
-	    // PHONGNORMALS
-	}	
-    }
+    // PHONGNORMALS
 
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
 }
 
 
@@ -2467,7 +2215,7 @@ void SubdivideBezierPatch(MyMathTypes::bezier_patch const& Patch, int SubdivLeve
 	}
 
 	if (VisualizationStyle == ShadedPatch) {
-	    render_pipeline.load_rasterizer(triangle_rasterizer);
+	    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 	    render_pipeline.load_vertex_program(transform_vertex_program);
 	    render_pipeline.load_fragment_program(phong_fragment_program);
 
@@ -2500,7 +2248,7 @@ void SubdivideBezierPatch(MyMathTypes::bezier_patch const& Patch, int SubdivLeve
 	}
 
 	if (VisualizationStyle == GouraudPatch) {
-	    render_pipeline.load_rasterizer(triangle_rasterizer);
+	    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 	    render_pipeline.load_vertex_program(transform_vertex_program);
 	    //render_pipeline.load_fragment_program(identity_fragment_program);
 
@@ -2600,8 +2348,8 @@ void FowardDiffBezierPatch(MyMathTypes::bezier_patch const& Patch, int step_coun
     MyMathTypes::bezier_patch DD = E * M * Patch * M.T() * E.T();
 
     bool first_row(true);
-    MyMathTypes::vector3_type    last_point_set[step_count];
-    MyMathTypes::vector3_type    cur_point_set[step_count];
+    MyMathTypes::vector3_type    last_point_set[step_count + 1];
+    MyMathTypes::vector3_type    cur_point_set[step_count + 1];
     MyMathTypes::vector3_type    cur_row[5];
 
     for (int i = 0; i <= step_count; i++)
@@ -2614,7 +2362,7 @@ void FowardDiffBezierPatch(MyMathTypes::bezier_patch const& Patch, int step_coun
 
         for (int j = 1; j <= step_count; j++)
         {
-            for (int k = 1; k <= 4; k++)
+            for (int k = 1; k <= 3; k++)
                 cur_row[k] += cur_row[k + 1];
 
             cur_point_set[j] = cur_row[1];
@@ -2660,7 +2408,7 @@ void FowardDiffBezierPatch(MyMathTypes::bezier_patch const& Patch, int step_coun
 
                 if (VisualizationStyle == ShadedPatch)
                 {
-                    render_pipeline.load_rasterizer(triangle_rasterizer);
+                    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
                     render_pipeline.load_vertex_program(transform_vertex_program);
                     render_pipeline.load_fragment_program(phong_fragment_program);
 
@@ -2687,7 +2435,7 @@ void FowardDiffBezierPatch(MyMathTypes::bezier_patch const& Patch, int step_coun
 
                 if (VisualizationStyle == GouraudPatch)
 				{
-					render_pipeline.load_rasterizer(triangle_rasterizer);
+					render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 					render_pipeline.load_vertex_program(transform_vertex_program);
 					//render_pipeline.load_fragment_program(phong_fragment_program);
 
@@ -2710,6 +2458,60 @@ void FowardDiffBezierPatch(MyMathTypes::bezier_patch const& Patch, int step_coun
     }
 }
 
+/*******************************************************************\
+*                                                                   *
+*         D r a w A d a p t i v e B e z i e r P a t c h e s         *
+*                                                                   *
+\*******************************************************************/
+
+#include "solution/adaptivebezier.h"
+
+// Keeps its buffers from frame to frame
+AdaptiveBezierMesh<MyMathTypes> adaptive_bezier_mesh;
+
+void DrawAdaptiveBezierPatches(std::vector<MyMathTypes::bezier_patch> const& BezierPatches,
+			       std::vector<bool> const& InvertNormals, DrawStyle VisualizationStyle)
+{
+    // The tessellation depends on the view, so it is done again in every frame
+    adaptive_bezier_mesh.tessellate(BezierPatches, InvertNormals,
+				    render_pipeline.state().model_projection(),
+				    cwhite);
+
+    std::vector<MyMathTypes::vector3_type> const& vertices = adaptive_bezier_mesh.vertices();
+    std::vector<int> const&                       indices  = adaptive_bezier_mesh.indices();
+
+    if (VisualizationStyle == ShadedPatch) {
+	render_pipeline.load_rasterizer(*current_triangle_rasterizer);
+	render_pipeline.load_vertex_program(transform_vertex_program);
+	render_pipeline.load_fragment_program(phong_fragment_program);
+
+	render_pipeline.draw_indexed_triangles(vertices, adaptive_bezier_mesh.normals(),
+					       adaptive_bezier_mesh.colors(), indices);
+    }
+
+    if (VisualizationStyle == ControlGrid) {
+	// Draw the edges of the triangles
+	render_pipeline.load_rasterizer(line_rasterizer);
+	render_pipeline.load_vertex_program(transform_vertex_program);
+	render_pipeline.load_fragment_program(identity_fragment_program);
+
+	for (std::size_t i = 0; i < indices.size(); i += 3) {
+	    render_pipeline.draw_line(vertices[indices[i]],     cwhite, vertices[indices[i + 1]], cwhite);
+	    render_pipeline.draw_line(vertices[indices[i + 1]], cwhite, vertices[indices[i + 2]], cwhite);
+	    render_pipeline.draw_line(vertices[indices[i + 2]], cwhite, vertices[indices[i]],     cwhite);
+	}
+    }
+
+    if (VisualizationStyle == GouraudPatch) {
+	render_pipeline.load_rasterizer(*current_triangle_rasterizer);
+	render_pipeline.load_vertex_program(transform_vertex_program);
+
+	render_pipeline.draw_indexed_triangles(vertices, adaptive_bezier_mesh.normals(),
+					       adaptive_bezier_mesh.colors(), indices);
+    }
+}
+
+
 /*******************************************************************\
 *                                                                   *
 *                D r a w B e z i e r P a t c h e s                  *
@@ -2719,6 +2521,11 @@ void FowardDiffBezierPatch(MyMathTypes::bezier_patch const& Patch, int step_coun
 void DrawBezierPatches(std::vector<MyMathTypes::bezier_patch> const& BezierPatches, int SubdivLevel,
         std::vector<bool> const& InvertNormals, DrawStyle VisualizationStyle)
 {
+    if (cur_curve_model == cmAdaptive) {
+	DrawAdaptiveBezierPatches(BezierPatches, InvertNormals, VisualizationStyle);
+	return;
+    }
+
     BoundingBox<MyMathTypes> BB;
 
     // Record the BoundingBox
@@ -2741,6 +2548,9 @@ void DrawBezierPatches(std::vector<MyMathTypes::bezier_patch> const& BezierPatch
             case cmForwardDifferencing:
                 FowardDiffBezierPatch(Patch, forward_diff_steps, InvertNormals[p], VisualizationStyle);
                 break;
+            case cmAdaptive:
+                // Handled by DrawAdaptiveBezierPatches() above
+                break;
         }
         ++p;
     }
@@ -2843,12 +2653,11 @@ void DrawUTAHTeapot()
 *                                                                   *
 \*******************************************************************/
 
-    std::vector<MyMathTypes::bezier_patch> BezierPatches;
-    
-    int fail = ReadBezierPatches("./src/data/teapot.data", BezierPatches);
-    if (fail) {
+    BezierPatchSet PatchSet = LoadBezierPatches("./src/data/teapot.data");
+    if (!PatchSet) {
 	throw std::runtime_error("DrawUTAHTeapot: failed to read the file: ./src/data/teapot.data");
     }
+    std::vector<MyMathTypes::bezier_patch> const& BezierPatches = *PatchSet;
     
     // std::cout << "The Bezier Patches read:" << std::endl;
     // std::cout << "========================" << std::endl;
@@ -2860,13 +2669,12 @@ void DrawUTAHTeapot()
     std::vector<bool> InvertNormals(BezierPatches.size(), true);
     
     MyMathTypes::real_type rotation_angle = 45.0 * M_PI /  180.0;
-    render_pipeline.state().model()     = Z_Rotate(rotation_angle);
-    render_pipeline.state().inv_model() = Inv_Z_Rotate(rotation_angle);
+    render_pipeline.state().set_model(Z_Rotate(rotation_angle), Inv_Z_Rotate(rotation_angle));
 
     int  SubdivLevel;
 
     SubdivLevel = 3;
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 
     if(figure == 'N'){
     	render_pipeline.load_fragment_program(identity_fragment_program);
@@ -2878,8 +2686,7 @@ void DrawUTAHTeapot()
 		DrawBezierPatches(BezierPatches, SubdivLevel, InvertNormals, ShadedPatch);
     }
 
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
 }
 
 
@@ -2980,12 +2787,11 @@ void DrawRocket()
 *                                                                   *
 \*******************************************************************/
 
-    std::vector<MyMathTypes::bezier_patch> BezierPatches;
-    
-    int fail = ReadBezierPatches("./src/data/rocket.data", BezierPatches);
-    if (fail) {
+    BezierPatchSet PatchSet = LoadBezierPatches("./src/data/rocket.data");
+    if (!PatchSet) {
 	throw std::runtime_error("DrawRocket: failed to read the file: ./src/data/rocket.data");
     }
+    std::vector<MyMathTypes::bezier_patch> const& BezierPatches = *PatchSet;
     
     std::vector<bool> InvertNormals(BezierPatches.size(), true);
 
@@ -2994,8 +2800,7 @@ void DrawRocket()
     MyMathTypes::matrix4x4_type M    = X_Rotate(rotation_angle) * Translate(t);
     MyMathTypes::matrix4x4_type InvM = InvTranslate(t) * Inv_X_Rotate(rotation_angle);
 
-    render_pipeline.state().model()     = M;
-    render_pipeline.state().inv_model() = InvM;
+    render_pipeline.state().set_model(M, InvM);
 
 
     // Translate the patch and scale it.
@@ -3019,7 +2824,7 @@ void DrawRocket()
     int  SubdivLevel;
 
     SubdivLevel = 3;
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 
     if(figure == 'Z'){
     	render_pipeline.load_fragment_program(identity_fragment_program);
@@ -3031,8 +2836,7 @@ void DrawRocket()
 		DrawBezierPatches(TransformedBezierPatches, SubdivLevel, InvertNormals, ShadedPatch);
     }
 
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
 }
 
 
@@ -3134,12 +2938,11 @@ void DrawSailboat()
 *                                                                   *
 \*******************************************************************/
 
-    std::vector<MyMathTypes::bezier_patch> BezierPatches;
-
-    int fail = ReadBezierPatches("./src/data/patches.data", BezierPatches);
-    if (fail) {
+    BezierPatchSet PatchSet = LoadBezierPatches("./src/data/patches.data");
+    if (!PatchSet) {
 	throw std::runtime_error("DrawSailboat: failed to read the file: ./src/data/patches.data");
     }
+    std::vector<MyMathTypes::bezier_patch> const& BezierPatches = *PatchSet;
     
     // std::cout << "The Bezier Patches read:" << std::endl;
     // std::cout << "========================" << std::endl;
@@ -3171,7 +2974,7 @@ void DrawSailboat()
     }
     
     int  SubdivLevel   = 2;
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(transform_vertex_program);
 
     if(figure == 'V'){
@@ -3184,8 +2987,7 @@ void DrawSailboat()
 		DrawBezierPatches(TransformedBezierPatches, SubdivLevel, InvertNormals, ShadedPatch);
     }
 
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
 }
 
 
@@ -3285,12 +3087,13 @@ void DrawPain()
 *                                                                   *
 \*******************************************************************/
 
-    std::vector<MyMathTypes::bezier_patch> BezierPatches;
-    
-    int fail = ReadBezierPatches("./src/data/pain.data", BezierPatches);
-    if (fail) {
+    BezierPatchSet PatchSet = LoadBezierPatches("./src/data/pain.data");
+    if (!PatchSet) {
 	throw std::runtime_error("DrawPain: failed to read the file: ./src/data/pain.data");
     }
+
+    //--- The patches are scaled below, so they are copied from the shared ones
+    std::vector<MyMathTypes::bezier_patch> BezierPatches(*PatchSet);
     
     // std::cout << "The Bezier Patches read:" << std::endl;
     // std::cout << "========================" << std::endl;
@@ -3307,13 +3110,12 @@ void DrawPain()
     std::vector<bool> InvertNormals(BezierPatches.size(), false);
 
     MyMathTypes::real_type rotation_angle = 45.0 * M_PI /  180.0;
-    render_pipeline.state().model()     = Z_Rotate(rotation_angle);
-    render_pipeline.state().inv_model() = Inv_Z_Rotate(rotation_angle);
+    render_pipeline.state().set_model(Z_Rotate(rotation_angle), Inv_Z_Rotate(rotation_angle));
 
     int  SubdivLevel;
 
     SubdivLevel = 5;
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 
     if(figure == 'B'){
     	render_pipeline.load_fragment_program(identity_fragment_program);
@@ -3325,8 +3127,7 @@ void DrawPain()
 		DrawBezierPatches(BezierPatches, SubdivLevel, InvertNormals, ShadedPatch);
     }
 
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
 }
 
 
@@ -3447,8 +3248,10 @@ void DrawIcosahedron()
     render_pipeline.load_vertex_program(transform_vertex_program);
     render_pipeline.load_fragment_program(phong_fragment_program);
 
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
+
+    // The icosahedron is closed, and its triangles are counter-clockwise seen from outside
+    render_pipeline.state().cull_face() = RenderPipeline<MyMathTypes>::graphics_state_type::cull_back;
 
 
 /*******************************************************************\
@@ -3535,7 +3338,7 @@ void DrawIcosahedron()
     // Draw the triangles as shaded triangles
     std::cout << "Draw the triangles as shaded triangles" << std::endl;
 
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(transform_vertex_program);
     render_pipeline.load_fragment_program(phong_fragment_program);
 
@@ -3553,7 +3356,7 @@ void DrawIcosahedron()
 	    N /= Norm(N);
 	}
 
-	render_pipeline.load_rasterizer(triangle_rasterizer);
+	render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 	render_pipeline.load_vertex_program(transform_vertex_program);
 	render_pipeline.load_fragment_program(phong_fragment_program);
 
@@ -3593,7 +3396,7 @@ void DrawIcosahedron()
 	    N3 /= Norm(N3);
 	}
 
-	render_pipeline.load_rasterizer(triangle_rasterizer);
+	render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 	render_pipeline.load_vertex_program(transform_vertex_program);
 	render_pipeline.load_fragment_program(phong_fragment_program);
 
@@ -3621,7 +3424,7 @@ void DrawIcosahedron()
 void SubDivideTriangle(Icosahedron::triangle const& T, int t_subdiv)
 {
     if (t_subdiv <= 0) {
-	render_pipeline.load_rasterizer(triangle_rasterizer);
+	render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 	render_pipeline.load_vertex_program(transform_vertex_program);
 	render_pipeline.load_fragment_program(identity_fragment_program);
 
@@ -3640,15 +3443,14 @@ void SubDivideTriangle(Icosahedron::triangle const& T, int t_subdiv)
 	if (!Zero(N_2)) N_2 /= Norm(N_2);
 
 	// draw the triangle
-	render_pipeline.load_rasterizer(triangle_rasterizer);
+	render_pipeline.load_rasterizer(*current_triangle_rasterizer);
 	render_pipeline.load_vertex_program(transform_vertex_program);
 	render_pipeline.load_fragment_program(phong_fragment_program);
 
 	render_pipeline.draw_triangle(T[0], N_0, cwhite, T[1], N_1, cwhite, T[2], N_2, cwhite);
     }
     else {
-	render_pipeline.state().model()     = Identity();
-	render_pipeline.state().inv_model() = Identity();
+	render_pipeline.state().set_model(Identity());
 
 	Icosahedron::vertex v1 = T[0];
 	Icosahedron::vertex v2 = T[1];
@@ -3798,12 +3600,14 @@ void DrawSubDividedIcosahedron()
 *                                                                   *
 \*******************************************************************/
 
-    render_pipeline.load_rasterizer(triangle_rasterizer);
+    render_pipeline.load_rasterizer(*current_triangle_rasterizer);
     render_pipeline.load_vertex_program(transform_vertex_program);
     render_pipeline.load_fragment_program(identity_fragment_program);
     
-    render_pipeline.state().model()     = Identity();
-    render_pipeline.state().inv_model() = Identity();
+    render_pipeline.state().set_model(Identity());
+
+    // The subdivided icosahedron is closed as well
+    render_pipeline.state().cull_face() = RenderPipeline<MyMathTypes>::graphics_state_type::cull_back;
 
 
 /*******************************************************************\
@@ -3830,6 +3634,8 @@ void DrawSubDividedIcosahedron()
 *                                                                   *
 \*******************************************************************/
 
+#ifndef GRAPHICS_HEADLESS
+
 /*******************************************************************\
 *                                                                   *
 *                         r e s h a p e ( )                         *
@@ -3870,6 +3676,12 @@ void usage()
     std::cout << "\tr : Reset the Camera"              << std::endl << std::flush;
     std::cout << std::endl << std::flush;
 
+    std::cout << "\to : Toggle Multithreaded Tile Binning" << std::endl << std::flush;
+    std::cout << "\ty : Toggle Half-Space Triangle Rasterizer" << std::endl << std::flush;
+    std::cout << "\tH : Toggle Early Depth Test in the Scanline Triangle Rasterizer" << std::endl << std::flush;
+    std::cout << "\tA : Cycle the Tessellation of Bezier Patches (Forward Differencing, Subdivision, Adaptive)" << std::endl << std::flush;
+    std::cout << std::endl << std::flush;
+
     std::cout << "\tPoints:"                           << std::endl << std::flush;
     std::cout << "\t-------"                           << std::endl << std::flush;
     std::cout << "\tp : Draw Points"                   << std::endl << std::flush;
@@ -3987,6 +3799,60 @@ void keyboard(unsigned char Key, int Xmouse, int Ymouse)
 	figure = 'r';
 	glutPostRedisplay();
 	break;
+    case 'o':
+    case 'O':
+	// toggle the tile-based multithreaded rasterization
+	if (render_pipeline.binning()) {
+	    render_pipeline.disable_binning();
+	    std::cout << "Tile Binning Off" << std::endl << std::flush;
+	}
+	else {
+	    render_pipeline.enable_binning();
+	    std::cout << "Tile Binning On" << std::endl << std::flush;
+	}
+	glutPostRedisplay();
+	break;
+    case 'y':
+    case 'Y':
+	// toggle between the scanline and the half-space triangle rasterizer
+	if (current_triangle_rasterizer == &triangle_rasterizer) {
+	    current_triangle_rasterizer = &halfspace_rasterizer;
+	    std::cout << "Half-Space Triangle Rasterizer" << std::endl << std::flush;
+	}
+	else {
+	    current_triangle_rasterizer = &triangle_rasterizer;
+	    std::cout << "Scanline Triangle Rasterizer" << std::endl << std::flush;
+	}
+	glutPostRedisplay();
+	break;
+    case 'H':
+	// toggle the early depth test, which only interpolates the attributes
+	// of the fragments that pass the z-test
+	if (triangle_rasterizer.EarlyDepthOn()) {
+	    triangle_rasterizer.EarlyDepthOff();
+	    std::cout << "Early Depth Test Off" << std::endl << std::flush;
+	}
+	else {
+	    std::cout << "Early Depth Test On" << std::endl << std::flush;
+	}
+	glutPostRedisplay();
+	break;
+    case 'A':
+	// cycle through the tessellations of the Bezier patches
+	if (cur_curve_model == cmForwardDifferencing) {
+	    cur_curve_model = cmSubdivision;
+	    std::cout << "Bezier Patches by Subdivision" << std::endl << std::flush;
+	}
+	else if (cur_curve_model == cmSubdivision) {
+	    cur_curve_model = cmAdaptive;
+	    std::cout << "Bezier Patches by Adaptive Subdivision" << std::endl << std::flush;
+	}
+	else {
+	    cur_curve_model = cmForwardDifferencing;
+	    std::cout << "Bezier Patches by Forward Differencing" << std::endl << std::flush;
+	}
+	glutPostRedisplay();
+	break;
     case 'p':
 	// draw points
 	std::cout << "Draw Point" << std::endl << std::flush;
@@ -4200,6 +4066,9 @@ void keyboard(unsigned char Key, int Xmouse, int Ymouse)
     //glutPostRedisplay();
 }
 
+// GRAPHICS_HEADLESS
+#endif
+
 
 /*******************************************************************\
 *                                                                   *
@@ -4211,8 +4080,10 @@ void display()
 {
     // This is where things happen! - all of your drawings should go here!
 
+#ifndef GRAPHICS_HEADLESS
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
     glMatrixMode( GL_MODELVIEW );
+#endif
     //////////////////////////////////////////////////////////////////
     
     // >> TODO USE YOUR SOFTWARE RENDERPIPEINE TO DRAW << 
@@ -4227,6 +4098,9 @@ void display()
        
     render_pipeline.clear( infinity, color );
 
+    // Only the scenes of closed meshes turn on back-face culling
+    render_pipeline.state().cull_face() = RenderPipeline<MyMathTypes>::graphics_state_type::cull_none;
+
 
 /*******************************************************************\
 *                                                                   *
@@ -4249,7 +4123,9 @@ void display()
     if (figure == 'r') {
 	ResetCamera();
 	figure = 'c';
+#ifndef GRAPHICS_HEADLESS
 	glutPostRedisplay();
+#endif
     }
 
 
@@ -4627,6 +4503,7 @@ void display()
 
     render_pipeline.flush();
     
+#ifndef GRAPHICS_HEADLESS
     glFinish();
     bool AnyErrors = false;
     GLenum ErrorCode = GL_NO_ERROR;
@@ -4645,6 +4522,7 @@ void display()
 
     glutSwapBuffers();
     //glutPostRedisplay();
+#endif
 }
 
 
@@ -4661,6 +4539,8 @@ void program_cleanup()
 }
 
 
+#ifndef GRAPHICS_HEADLESS
+
 /*******************************************************************\
 *                                                                   *
 *                     R e f r e s h M e n u ( )                     *
@@ -5025,6 +4905,9 @@ int main( int argc, char **argv )
 	
 	//--- allocate memory
 	render_pipeline.set_resolution(winWidth, winHeight );
+
+	//--- the window shows 8 bits per channel, so there is no need for more
+	render_pipeline.set_pixel_format( RenderPipeline<MyMathTypes>::frame_buffer_type::rgba8 );
     
 	//--- set up graphics state
 	render_pipeline.state().ambient_intensity() = 0.5;
@@ -5050,3 +4933,166 @@ int main( int argc, char **argv )
 
     return 0;
 }
+
+#else
+
+/*******************************************************************\
+*                                                                   *
+*                   H e a d l e s s   S c e n e s                   *
+*                                                                   *
+\*******************************************************************/
+
+// The scenes which can be rendered without a window, and the key which draws
+// them in the interactive program. The debug figures are left out, because
+// they are meant to be stepped through with the keyboard.
+struct HeadlessScene
+{
+    char const* name;
+    char        key;
+    int         curve_model;   // The tessellation of the Bezier patches, 0 for the default
+};
+
+HeadlessScene const headless_scenes[] = {
+    { "points",                 'p', 0          },
+    { "lines",                  'l', 0          },
+    { "triangles",              't', 0          },
+    { "gouraud-triangles",      's', 0          },
+    { "hidden-surfaces",        'h', 0          },
+    { "phong-triangles",        'a', 0          },
+    { "foley-6.27",             '1', 0          },
+    { "foley-6.28",             '2', 0          },
+    { "foley-6.31",             '3', 0          },
+    { "foley-6.22",             '4', 0          },
+    { "foley-6.34",             '5', 0          },
+    { "bezier-fwd",             'f', 0          },
+    { "bezier-subdivision",     'w', 0          },
+    { "klein",                  'k', 0          },
+    { "klein-interior",         'm', 0          },
+    { "klein-gouraud",          'M', 0          },
+    { "phong-surface",          'x', 0          },
+    { "phong-surface-gouraud",  'X', 0          },
+    { "teapot",                 'n', 0          },
+    { "teapot-gouraud",         'N', 0          },
+    { "teapot-adaptive",        'n', cmAdaptive },
+    { "rocket",                 'z', 0          },
+    { "rocket-gouraud",         'Z', 0          },
+    { "sailboat",               'v', 0          },
+    { "sailboat-gouraud",       'V', 0          },
+    { "sailboat-adaptive",      'v', cmAdaptive },
+    { "pain",                   'b', 0          },
+    { "pain-gouraud",           'B', 0          },
+    { "icosahedron",            'e', 0          },
+    { "icosahedron-subdivided", 'E', 0          },
+    { "dini",                   'j', 0          },
+    { "dini-gouraud",           'J', 0          }
+};
+
+
+/*******************************************************************\
+*                                                                   *
+*                  h e a d l e s s _ u s a g e ( )                  *
+*                                                                   *
+\*******************************************************************/
+
+void headless_usage(char const* program)
+{
+    std::cout << "Usage: " << program << " <scene> <image file> [<width> <height>] [<pixel format>]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Renders a scene without a window and saves it as a .ppm, .png, or .exr file." << std::endl;
+    std::cout << "The statistics of the render pipeline are printed afterwards." << std::endl;
+    std::cout << "The default resolution is " << winWidth << " x " << winHeight << "." << std::endl;
+    std::cout << "The pixel format is rgb-float (the default), rgba8, or rgb565." << std::endl;
+    std::cout << std::endl;
+    std::cout << "Scenes:" << std::endl;
+    for (unsigned int i = 0; i < sizeof(headless_scenes) / sizeof(headless_scenes[0]); ++i) {
+	std::cout << "\t" << headless_scenes[i].name << std::endl;
+    }
+}
+
+
+// src/bench.cpp includes this file for the scenes, and has its own main()
+#ifndef GRAPHICS_BENCHMARK
+
+/*******************************************************************\
+*                                                                   *
+*                            m a i n ( )                            *
+*                                                                   *
+\*******************************************************************/
+
+int main( int argc, char **argv )
+{
+    if ((argc < 3) || (argc > 6)) {
+	headless_usage(argv[0]);
+	return 1;
+    }
+
+    try {
+	figure = 0;
+	for (unsigned int i = 0; i < sizeof(headless_scenes) / sizeof(headless_scenes[0]); ++i) {
+	    if (std::string(argv[1]) == headless_scenes[i].name) {
+		figure = headless_scenes[i].key;
+		if (headless_scenes[i].curve_model != 0)
+		    cur_curve_model = static_cast<CurveModels>(headless_scenes[i].curve_model);
+	    }
+	}
+	if (figure == 0) {
+	    std::cout << "Unknown scene '" << argv[1] << "'" << std::endl << std::endl;
+	    headless_usage(argv[0]);
+	    return 1;
+	}
+
+	if (argc >= 5) {
+	    std::istringstream(argv[3]) >> winWidth;
+	    std::istringstream(argv[4]) >> winHeight;
+	}
+
+	RenderPipeline<MyMathTypes>::pixel_format_type pixel_format = RenderPipeline<MyMathTypes>::frame_buffer_type::rgb_float;
+	if ((argc == 4) || (argc == 6)) {
+	    std::string name(argv[argc - 1]);
+	    if (name == "rgba8")
+		pixel_format = RenderPipeline<MyMathTypes>::frame_buffer_type::rgba8;
+	    else if (name == "rgb565")
+		pixel_format = RenderPipeline<MyMathTypes>::frame_buffer_type::rgb565;
+	    else if (name != "rgb-float") {
+		std::cout << "Unknown pixel format '" << name << "'" << std::endl << std::endl;
+		headless_usage(argv[0]);
+		return 1;
+	    }
+	}
+
+	// Show the whole icosahedron, and the finest subdivision of it
+	t        = tmax;
+	t_subdiv = t_subdiv_max;
+
+	//--- connect hardware
+	render_pipeline.load_vertex_program( identity_vertex_program );
+	render_pipeline.load_fragment_program( identity_fragment_program );
+
+	//--- allocate memory
+	render_pipeline.set_resolution(winWidth, winHeight );
+	render_pipeline.set_pixel_format( pixel_format );
+
+	//--- set up graphics state
+	render_pipeline.state().ambient_intensity() = 0.5;
+
+	//--- init camera
+	camera.init( render_pipeline );
+
+	//--- draw the scene exactly like the interactive program does
+	display();
+	render_pipeline.save(argv[2]);
+	render_pipeline.statistics().print(std::cout);
+    }
+    catch (std::exception const& Exception) {
+	std::cout << Exception.what() << std::endl;
+	return 1;
+    }
+
+    return 0;
+}
+
+// GRAPHICS_BENCHMARK
+#endif
+
+// GRAPHICS_HEADLESS
+#endif
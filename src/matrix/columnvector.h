@@ -22,10 +22,10 @@ public:
     #ifdef PARAM
     ColumnVector(Type const FirstValue ...);
     #endif
-    ColumnVector(ColumnVector<Type,N> const& Src);
-    virtual ~ColumnVector();
+    ColumnVector(ColumnVector<Type,N> const& Src) = default;
+    ~ColumnVector() = default;
     RowVector<Type,N> T() const;
-    ColumnVector<Type,N> const& operator=(ColumnVector<Type,N> const& Src);
+    ColumnVector<Type,N>& operator=(ColumnVector<Type,N> const& Src) = default;
     ColumnVector<Type,N> const& operator+() const;
     ColumnVector<Type,N> operator+(ColumnVector<Type,N> const& Src) const;
     ColumnVector<Type,N> const& operator+=(ColumnVector<Type,N> const& Src);
@@ -12,6 +12,11 @@
 #include <matrix/rowvector.h>
 #include <matrix/columnvector.h>
 
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(RM_MATRIX_NO_SIMD)
+#define RM_MATRIX_SIMD
+#include <emmintrin.h>
+#endif
+
 typedef enum{NoPivoting, PartialPivoting, CompletePivoting} PivotType;
 
 template<typename Type, unsigned int M, unsigned int N>
@@ -21,8 +26,8 @@ public:
     #ifdef PARAM
     Matrix(Type const FirstValue ...);
     #endif
-    Matrix(Matrix<Type,M,N> const& Src);
-    virtual ~Matrix();
+    Matrix(Matrix<Type,M,N> const& Src) = default;
+    ~Matrix() = default;
     unsigned int const Rows() const;
     RowVector<Type,N> Row(unsigned int const Index) const;
     RowVector<Type,N> Row(unsigned int const Index, RowVector<Type,N> const& NewRow);
@@ -41,7 +46,7 @@ public:
     void Clear();
     void Put(std::ostream& s, int width = 0) const;
     void Get(std::istream& s);
-    Matrix const& operator=(Matrix const& Src);
+    Matrix& operator=(Matrix const& Src) = default;
     RowVector<Type,N>&       operator[](unsigned int const Index);
     RowVector<Type,N> const& operator[](unsigned int const Index) const;
     bool const operator==(Matrix<Type,M,N> const& Src) const;
@@ -59,6 +64,7 @@ public:
 protected:
     /* No Protected Members so far */
 private:
+    // The rows one after the other, e.g. 64 contiguous bytes for 4 x 4 floats
     ColumnVector<RowVector<Type,N>,M> data;
     /* No Private Member Functions so far*/
     /* No Friends so far */
@@ -73,6 +79,15 @@ Real Norm(Matrix<Type,M,N> const& Mat, unsigned int const p = 1);
 #endif
 template<typename Type, unsigned int M>
 Matrix<Type,M,M> Inverse(Matrix<Type,M,M> const& A, Type const epsilon = Type());
+// Closed form inverses of 4 x 4 transformations. RigidInverse assumes that A
+// is a rotation followed by a translation, AffineInverse that the last row
+// of A is (0, 0, 0, 1), and CofactorInverse inverts any regular matrix.
+template<typename Type>
+Matrix<Type,4,4> RigidInverse(Matrix<Type,4,4> const& A);
+template<typename Type>
+Matrix<Type,4,4> AffineInverse(Matrix<Type,4,4> const& A);
+template<typename Type>
+Matrix<Type,4,4> CofactorInverse(Matrix<Type,4,4> const& A);
 template<typename Type, unsigned int M>
 ColumnVector<Type,M> 
 Solve(Matrix<Type,M,M> const& Amatrix, ColumnVector<Type,M> const& Bvector,
@@ -94,6 +109,28 @@ Matrix<Type,M,N> operator*(Matrix<Type,M,K> const& Src1,
                            Matrix<Type,K,N> const& Src2);
 template<typename Type, unsigned int M, unsigned int N>
 Matrix<Type,M,N> operator*(ColumnVector<Type,M> const& Col, RowVector<Type,N> const& Row);
+template<typename Type>
+void Transform(Matrix<Type,4,4> const& Mat, ColumnVector<Type,4> const* Src,
+               ColumnVector<Type,4>* Dest, unsigned int const Count);
+template<typename Type>
+void TransformPoints(Matrix<Type,4,4> const& Mat, ColumnVector<Type,3> const* Src,
+                     ColumnVector<Type,4>* Dest, unsigned int const Count);
+#ifdef RM_MATRIX_SIMD
+// The 4 x 4 products of the homogeneous coordinates use SSE. They are
+// overloads, not specialisations, so they are preferred to the templates.
+inline Matrix<float,4,4> operator*(Matrix<float,4,4> const& Src1,
+                                   Matrix<float,4,4> const& Src2);
+inline ColumnVector<float,4> operator*(Matrix<float,4,4> const& Mat,
+                                       ColumnVector<float,4> const& Vec);
+inline Matrix<double,4,4> operator*(Matrix<double,4,4> const& Src1,
+                                    Matrix<double,4,4> const& Src2);
+inline ColumnVector<double,4> operator*(Matrix<double,4,4> const& Mat,
+                                        ColumnVector<double,4> const& Vec);
+inline void Transform(Matrix<float,4,4> const& Mat, ColumnVector<float,4> const* Src,
+                      ColumnVector<float,4>* Dest, unsigned int const Count);
+inline void TransformPoints(Matrix<float,4,4> const& Mat, ColumnVector<float,3> const* Src,
+                            ColumnVector<float,4>* Dest, unsigned int const Count);
+#endif
 template<typename Type, unsigned int M, unsigned int N>
 std::ostream& operator<<(std::ostream& s, Matrix<Type,M,N> const& Src);
 template<typename Type, unsigned int M, unsigned int N>
@@ -18,8 +18,8 @@ public:
     Quaternion(Type const& Scalar, Vector<Type,3> const& Vec);
     Quaternion(Type const& Scalar);
     Quaternion(Vector<Type,3> const& Vec);
-    Quaternion(Quaternion<Type> const& Quat);
-    virtual ~Quaternion();
+    Quaternion(Quaternion<Type> const& Quat) = default;
+    ~Quaternion() = default;
     void Clear();
     void Put(std::ostream& s, int width = 0) const;
     void Get(std::istream& s);
@@ -33,7 +33,7 @@ public:
     Quaternion<Type> C() const;
     Real Norm() const;
     Quaternion<Type> I() const;
-    Quaternion<Type> const& operator=(Quaternion<Type> const& Src);
+    Quaternion<Type>& operator=(Quaternion<Type> const& Src) = default;
     Type& operator[](unsigned int const Index);
     Type const& operator[](unsigned int const Index) const;
     bool const operator==(Quaternion<Type> const& Src) const;
@@ -22,10 +22,10 @@ public:
     #ifdef PARAM
     RowVector(Type const FirstValue ...);
     #endif
-    RowVector(RowVector<Type,N> const& Src);
-    virtual ~RowVector();
+    RowVector(RowVector<Type,N> const& Src) = default;
+    ~RowVector() = default;
     ColumnVector<Type,N> T() const;
-    RowVector<Type,N> const& operator=(RowVector<Type,N> const& Src);
+    RowVector<Type,N>& operator=(RowVector<Type,N> const& Src) = default;
     RowVector<Type,N> const& operator+() const;
     RowVector<Type,N> operator+(RowVector<Type,N> const& Src) const;
     RowVector<Type,N> const& operator+=(RowVector<Type,N> const& Src);
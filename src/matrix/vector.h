@@ -24,8 +24,8 @@ public:
     #ifdef PARAM
     Vector(Type const FirstValue ...);
     #endif
-    Vector(Vector<Type,N> const& Src);
-    virtual ~Vector();
+    Vector(Vector<Type,N> const& Src) = default;
+    ~Vector() = default;
     unsigned int const Dimension() const;
     void Clear();
     void Put(std::ostream& s, int width = 0) const;
@@ -33,7 +33,7 @@ public:
     Type& Value(unsigned int const Index);
     Type const& Value(unsigned int const Index) const;
     Real Norm(unsigned int const p = 2) const;
-    Vector<Type,N> const& operator=(Vector<Type,N> const& Src);
+    Vector<Type,N>& operator=(Vector<Type,N> const& Src) = default;
     Type& operator[](unsigned int const Index);
     Type const& operator[](unsigned int const Index) const;
     bool const operator==(Vector<Type,N> const& Src) const;
@@ -52,8 +52,12 @@ public:
 protected:
     /* No Protected Members so far */
 private:
-    Type data[N];
+    // No vtable, so the components are all there is to a Vector, and it can
+    // be copied with memcpy. Vectors of 12 bytes or more are aligned like an
+    // SSE register, e.g. a vector of three floats takes 16 bytes.
+    alignas(sizeof(Type) * N >= 12 ? 16 : alignof(Type)) Type data[N];
     Type const& DataItem(unsigned int const Index) const;
+    [[noreturn]] void IndexError(unsigned int const Index) const;
     /* No Friends of class Vector */
 };
 
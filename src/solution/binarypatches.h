@@ -0,0 +1,273 @@
+#ifndef BINARYPATCHES_H
+#define BINARYPATCHES_H
+
+/*******************************************************************\
+*                                                                   *
+*                    B i n a r y   P a t c h e s                    *
+*                                                                   *
+\*******************************************************************/
+
+// A binary alternative to the .data text files of Bezier patches. A file
+// holds a vertex array and a table of patches, which index the vertices.
+// The layout is
+//
+//     BinaryPatchHeader                    24 bytes
+//     float    vertices[3 * vertex_count]  x, y, z
+//     uint32_t patches[16 * patch_count]   0-based vertex indices, row by row
+//
+// in the byte order of the machine which wrote it. Every section is a
+// multiple of 4 bytes, so a file can be mapped into memory and used in
+// place, without being parsed or copied. The patches are tessellated by
+// the renderer, which picks the curve model and level at run time, so no
+// tessellation is stored.
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+#include <stdint.h>
+
+#include "solution/math_types.h"
+
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+namespace graphics {
+
+    /**
+     * The header of a binary patch file.
+     */
+    struct BinaryPatchHeader
+    {
+	char     magic[8];      ///< "GFXPATCH"
+	uint32_t version;       ///< BinaryPatchVersion, also tells if the byte order matches.
+	uint32_t vertex_count;  ///< The number of control points.
+	uint32_t patch_count;   ///< The number of patches.
+	uint32_t reserved;      ///< Zero.
+    };
+
+    const uint32_t BinaryPatchVersion = 2;
+
+
+    /**
+     * Binary Patch File.
+     * A read-only view of a binary patch file. On POSIX systems the file is
+     * mapped into memory, and the arrays point straight into the mapping;
+     * elsewhere it is read into memory with a single read.
+     */
+    class BinaryPatchFile
+    {
+    public:
+	BinaryPatchFile() : m_data(0), m_size(0), m_header(0)
+	{}
+
+	~BinaryPatchFile()
+	{
+	    this->close();
+	}
+
+	/**
+	 * Open a binary patch file.
+	 *
+	 * @param filename  The name of the file.
+	 * @return true if the file could be opened and is a valid binary patch file.
+	 */
+	bool open(const char* filename)
+	{
+	    this->close();
+
+#if !defined(_WIN32)
+	    int file = ::open(filename, O_RDONLY);
+	    if (file < 0) {
+		std::cerr << "Cannot open data file: " << filename << std::endl << std::flush;
+		return false;
+	    }
+	    struct stat status;
+	    if ((fstat(file, &status) != 0) || (status.st_size < static_cast<off_t>(sizeof(BinaryPatchHeader)))) {
+		::close(file);
+		std::cerr << "Not a binary patch file: " << filename << std::endl << std::flush;
+		return false;
+	    }
+	    void* data = mmap(0, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	    ::close(file);
+	    if (data == MAP_FAILED) {
+		std::cerr << "Cannot map data file: " << filename << std::endl << std::flush;
+		return false;
+	    }
+	    this->m_data = static_cast<const char*>(data);
+	    this->m_size = status.st_size;
+#else
+	    std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+	    if (!file) {
+		std::cerr << "Cannot open data file: " << filename << std::endl << std::flush;
+		return false;
+	    }
+	    std::streamoff size = file.tellg();
+	    if (size < static_cast<std::streamoff>(sizeof(BinaryPatchHeader))) {
+		std::cerr << "Not a binary patch file: " << filename << std::endl << std::flush;
+		return false;
+	    }
+	    this->m_buffer.resize(static_cast<std::size_t>(size) / sizeof(uint32_t) + 1);
+	    file.seekg(0);
+	    if (!file.read(reinterpret_cast<char*>(&this->m_buffer[0]), size)) {
+		std::vector<uint32_t>().swap(this->m_buffer);
+		std::cerr << "Cannot read data file: " << filename << std::endl << std::flush;
+		return false;
+	    }
+	    this->m_data = reinterpret_cast<const char*>(&this->m_buffer[0]);
+	    this->m_size = static_cast<std::size_t>(size);
+#endif
+
+	    this->m_header = reinterpret_cast<const BinaryPatchHeader*>(this->m_data);
+	    if (!this->valid()) {
+		std::cerr << "Not a binary patch file: " << filename << std::endl << std::flush;
+		this->close();
+		return false;
+	    }
+	    return true;
+	}
+
+	/**
+	 * Close the file. The arrays are no longer valid afterwards.
+	 */
+	void close()
+	{
+#if !defined(_WIN32)
+	    if (this->m_data != 0)
+		munmap(const_cast<char*>(this->m_data), this->m_size);
+#else
+	    std::vector<uint32_t>().swap(this->m_buffer);
+#endif
+	    this->m_data   = 0;
+	    this->m_size   = 0;
+	    this->m_header = 0;
+	}
+
+	uint32_t vertex_count() const { return this->m_header->vertex_count; }
+	uint32_t patch_count()  const { return this->m_header->patch_count; }
+
+	/// The control points, 3 floats each.
+	const float* vertices() const
+	{
+	    return reinterpret_cast<const float*>(this->m_data + sizeof(BinaryPatchHeader));
+	}
+
+	/// The patches, 16 vertex indices each, row by row.
+	const uint32_t* patches() const
+	{
+	    return reinterpret_cast<const uint32_t*>(this->vertices() + 3ULL * this->vertex_count());
+	}
+
+    protected:
+	/// Tests the header, the size of the file, and the indices.
+	bool valid() const
+	{
+	    if (std::memcmp(this->m_header->magic, "GFXPATCH", 8) != 0)
+		return false;
+	    if (this->m_header->version != BinaryPatchVersion)
+		return false;
+
+	    unsigned long long size = sizeof(BinaryPatchHeader)
+		+ 4ULL * (3ULL * this->vertex_count() + 16ULL * this->patch_count());
+	    if (size != this->m_size)
+		return false;
+
+	    //--- The counts are computed in 64 bits, as the size, so a forged header cannot wrap them
+	    unsigned long long index_count = 16ULL * this->patch_count();
+	    for (unsigned long long i = 0; i < index_count; ++i) {
+		if (this->patches()[i] >= this->vertex_count())
+		    return false;
+	    }
+	    return true;
+	}
+
+    private:
+	BinaryPatchFile(BinaryPatchFile const&);
+	BinaryPatchFile& operator=(BinaryPatchFile const&);
+
+	const char*              m_data;
+	std::size_t              m_size;
+	const BinaryPatchHeader* m_header;
+#if defined(_WIN32)
+	std::vector<uint32_t>    m_buffer;
+#endif
+    };
+
+
+    /**
+     * Write a binary patch file.
+     *
+     * @param filename  The name of the file.
+     * @param vertices  The control points, 3 floats each.
+     * @param patches   The patches, 16 0-based indices into vertices each.
+     * @return 0 on success, -1 if the file cannot be written.
+     */
+    inline int WriteBinaryPatches(const char* filename,
+				  std::vector<float>    const& vertices,
+				  std::vector<uint32_t> const& patches)
+    {
+	BinaryPatchHeader header;
+	std::memcpy(header.magic, "GFXPATCH", 8);
+	header.version      = BinaryPatchVersion;
+	header.vertex_count = static_cast<uint32_t>(vertices.size() / 3);
+	header.patch_count  = static_cast<uint32_t>(patches.size() / 16);
+	header.reserved     = 0;
+
+	std::ofstream file(filename, std::ios::out | std::ios::binary);
+	if (!file) {
+	    std::cerr << "Cannot open data file: " << filename << std::endl << std::flush;
+	    return -1;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (!vertices.empty())
+	    file.write(reinterpret_cast<const char*>(&vertices[0]), 4ULL * 3 * header.vertex_count);
+	if (!patches.empty())
+	    file.write(reinterpret_cast<const char*>(&patches[0]), 4ULL * 16 * header.patch_count);
+	if (!file) {
+	    std::cerr << "Cannot write data file: " << filename << std::endl << std::flush;
+	    return -1;
+	}
+	return 0;
+    }
+
+
+    /**
+     * Read Bezier patches from a binary patch file, like ReadBezierPatches
+     * does from a .data file.
+     *
+     * @param filename       The name of the file.
+     * @param BezierPatches  The patches of the file are appended to this.
+     * @return 0 on success, -1 if the file cannot be read.
+     */
+    inline int ReadBinaryBezierPatches(const char* filename,
+				       std::vector<graphics::MyMathTypes::bezier_patch>& BezierPatches)
+    {
+	BinaryPatchFile file;
+	if (!file.open(filename))
+	    return -1;
+
+	const float*    vertices = file.vertices();
+	const uint32_t* indices  = file.patches();
+	BezierPatches.reserve(BezierPatches.size() + file.patch_count());
+	for (uint32_t p = 0; p < file.patch_count(); ++p) {
+	    graphics::MyMathTypes::bezier_patch BPatch;
+	    for (int i = 1; i <= 4; ++i) {
+		for (int j = 1; j <= 4; ++j) {
+		    const float* vertex = vertices + 3ULL * indices[16ULL * p + 4 * (i - 1) + (j - 1)];
+		    BPatch[i][j] = graphics::MyMathTypes::vector3_type(vertex[0], vertex[1], vertex[2]);
+		}
+	    }
+	    BezierPatches.push_back(BPatch);
+	}
+	return 0;
+    }
+
+}
+
+#endif
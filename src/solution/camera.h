@@ -114,14 +114,13 @@ namespace graphics {
 #endif
 
 	    matrix4x4_type ViewOrient = R * T;
-	    this->m_state->view_orientation() = ViewOrient;
 
 #if PRINT_MATRICES
 	    std::cout << "ViewOrient = R * T(-vrp) = " << ViewOrient << std::endl;
 #endif
 
 	    matrix4x4_type InvViewOrient = InvT * InvR;
-	    this->m_state->inv_view_orientation() = InvViewOrient;
+	    this->m_state->set_view_orientation(ViewOrient, InvViewOrient);
 
 #if PRINT_MATRICES
 	    std::cout << "InvViewOrient = T(vrp) * R.T() = " << InvViewOrient << std::endl;
@@ -230,8 +229,7 @@ namespace graphics {
 	    matrix4x4_type ViewProject    = Perp2Par * S_uniform * S_xy * Sh_xy * T;
 	    matrix4x4_type InvViewProject = InvT * InvSh_xy * InvS_uniform * InvPerp2Par;
 
-	    this->m_state->view_projection()     = ViewProject;
-	    this->m_state->inv_view_projection() = InvViewProject;
+	    this->m_state->set_view_projection(ViewProject, InvViewProject);
 
 #if PRINT_MATRICES
 	    std::cout << "ViewProject = " << ViewProject << std::endl;
@@ -280,7 +278,6 @@ namespace graphics {
 
 	    /// The final window-viewport transformation
 	    matrix4x4_type WindowViewport = T_screen * S_screen * T_wv;
-	    this->m_state->window_viewport() = WindowViewport;
 
 #if PRINT_MATRICES
 	    std::cout << "WindowViewport = " << WindowViewport << std::endl;
@@ -288,7 +285,7 @@ namespace graphics {
 
 
 	    matrix4x4_type InvWindowViewport = InvT_wv * InvS_screen * InvT_screen;
-	    this->m_state->inv_window_viewport() = InvWindowViewport;
+	    this->m_state->set_window_viewport(WindowViewport, InvWindowViewport);
 
 	    return WindowViewport;
 	}
@@ -526,6 +526,7 @@ namespace graphics {
 //		this->twoedges = false;
 		return true;
 	    }
+	    return false;
 	}
 
 
@@ -6,6 +6,10 @@
 //
 #include <iostream>
 #include <iomanip>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "graphics/graphics.h"
 
 namespace graphics {
@@ -65,6 +69,7 @@ template<typename math_types>
 	typedef typename FragmentProgram<math_types>::graphics_state_type graphics_state_type;
 	typedef typename math_types::vector3_type                         vector3_type;
 	typedef typename math_types::real_type                            real_type;
+	typedef typename FragmentProgram<math_types>::fragment_batch_type fragment_batch_type;
 
     public:
 	void run(graphics_state_type const& state,
@@ -182,6 +187,43 @@ template<typename math_types>
 	}
 
 
+/*******************************************************************\
+*                                                                   *
+*                         b a t c h e d ( )                         *
+*                                                                   *
+\*******************************************************************/
+
+	bool batched() const
+	{
+#if defined(__SSE2__)
+	    return std::is_same<real_type, float>::value;
+#else
+	    return false;
+#endif
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                    r u n _ b a t c h ( . . . )                    *
+*                                                                   *
+\*******************************************************************/
+
+	// Shades four fragments at a time with SSE, when real_type is float.
+	// Square roots and pow() are replaced by approximations, so a color
+	// channel may differ from the result of run() by up to 1e-4 (for a
+	// fall_off between 1 and 128). The messages about zero vectors are not
+	// printed; such vectors are simply left as zero.
+	void run_batch(graphics_state_type const& state, fragment_batch_type& batch)
+	{
+#if defined(__SSE2__)
+	    this->shade_batch(state, batch, std::is_same<real_type, float>());
+#else
+	    FragmentProgram<math_types>::run_batch(state, batch);
+#endif
+	}
+
+
     private:
 
 /*******************************************************************\
@@ -198,6 +240,210 @@ template<typename math_types>
 
 	    return result;
 	}
+
+
+#if defined(__SSE2__)
+
+/*******************************************************************\
+*                                                                   *
+*      s h a d e _ b a t c h ( . . . ,   f a l s e _ t y p e )      *
+*                                                                   *
+\*******************************************************************/
+
+	// The SSE path only handles floats
+	void shade_batch(graphics_state_type const& state, fragment_batch_type& batch, std::false_type)
+	{
+	    FragmentProgram<math_types>::run_batch(state, batch);
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*       s h a d e _ b a t c h ( . . . ,   t r u e _ t y p e )       *
+*                                                                   *
+\*******************************************************************/
+
+	void shade_batch(graphics_state_type const& state, fragment_batch_type& batch, std::true_type)
+	{
+	    __m128 const zero = _mm_setzero_ps();
+
+	    // The parts of the terms which are the same for all fragments
+	    real_type ambient[3];
+	    real_type diffuse[3];
+	    real_type specular[3];
+	    for (int i = 0; i < 3; ++i) {
+		ambient[i]  = this->Clamp(state.I_a()[i + 1] * state.ambient_intensity() * state.ambient_color()[i + 1]);
+		diffuse[i]  = state.I_p()[i + 1] * state.diffuse_intensity()  * state.diffuse_color()[i + 1];
+		specular[i] = state.I_p()[i + 1] * state.specular_intensity() * state.specular_color()[i + 1];
+	    }
+
+	    __m128 const eye_axis_x = _mm_set1_ps(state.z_eye_axis()[1]);
+	    __m128 const eye_axis_y = _mm_set1_ps(state.z_eye_axis()[2]);
+	    __m128 const eye_axis_z = _mm_set1_ps(state.z_eye_axis()[3]);
+	    __m128 const light_x    = _mm_set1_ps(state.light_position()[1]);
+	    __m128 const light_y    = _mm_set1_ps(state.light_position()[2]);
+	    __m128 const light_z    = _mm_set1_ps(state.light_position()[3]);
+	    __m128 const eye_x      = _mm_set1_ps(state.eye_position()[1]);
+	    __m128 const eye_y      = _mm_set1_ps(state.eye_position()[2]);
+	    __m128 const eye_z      = _mm_set1_ps(state.eye_position()[3]);
+
+	    for (int j = 0; j < batch.count; j += 4) {
+		__m128 Px = _mm_load_ps(&batch.position[0][j]);
+		__m128 Py = _mm_load_ps(&batch.position[1][j]);
+		__m128 Pz = _mm_load_ps(&batch.position[2][j]);
+
+		// Flip the normals which point away from the eye, like run() does
+		__m128 Nx = _mm_load_ps(&batch.normal[0][j]);
+		__m128 Ny = _mm_load_ps(&batch.normal[1][j]);
+		__m128 Nz = _mm_load_ps(&batch.normal[2][j]);
+		__m128 facing = Dot4(eye_axis_x, eye_axis_y, eye_axis_z, Nx, Ny, Nz);
+		__m128 flip   = _mm_and_ps(_mm_cmplt_ps(facing, _mm_set1_ps(-0.15f)), _mm_set1_ps(-0.0f));
+		Nx = _mm_xor_ps(Nx, flip);
+		Ny = _mm_xor_ps(Ny, flip);
+		Nz = _mm_xor_ps(Nz, flip);
+		Normalize4(Nx, Ny, Nz);
+
+		__m128 Lx = _mm_sub_ps(light_x, Px);
+		__m128 Ly = _mm_sub_ps(light_y, Py);
+		__m128 Lz = _mm_sub_ps(light_z, Pz);
+		Normalize4(Lx, Ly, Lz);
+
+		__m128 Vx = _mm_sub_ps(eye_x, Px);
+		__m128 Vy = _mm_sub_ps(eye_y, Py);
+		__m128 Vz = _mm_sub_ps(eye_z, Pz);
+		Normalize4(Vx, Vy, Vz);
+
+		// Only the fragments where L, N, and V are on the same side get diffuse and specular light
+		__m128 LdotN = Dot4(Lx, Ly, Lz, Nx, Ny, Nz);
+		__m128 VdotN = Dot4(Vx, Vy, Vz, Nx, Ny, Nz);
+		__m128 lit   = _mm_and_ps(_mm_cmpgt_ps(LdotN, zero), _mm_cmpgt_ps(VdotN, zero));
+
+		// N and L have unit length, so R has unit length and R * N = L * N > 0
+		__m128 twice_LdotN = _mm_add_ps(LdotN, LdotN);
+		__m128 Rx = _mm_sub_ps(_mm_mul_ps(Nx, twice_LdotN), Lx);
+		__m128 Ry = _mm_sub_ps(_mm_mul_ps(Ny, twice_LdotN), Ly);
+		__m128 Rz = _mm_sub_ps(_mm_mul_ps(Nz, twice_LdotN), Lz);
+
+		__m128 RdotV    = Clamp4(Dot4(Rx, Ry, Rz, Vx, Vy, Vz));
+		__m128 powRdotV = Clamp4(Pow4(RdotV, state.fall_off()));
+		LdotN = Clamp4(LdotN);
+
+		for (int i = 0; i < 3; ++i) {
+		    __m128 Diffuse_term  = Clamp4(_mm_mul_ps(_mm_set1_ps(diffuse[i]),  LdotN));
+		    __m128 Specular_term = Clamp4(_mm_mul_ps(_mm_set1_ps(specular[i]), powRdotV));
+		    __m128 color = _mm_add_ps(_mm_set1_ps(ambient[i]),
+					      _mm_and_ps(lit, _mm_add_ps(Diffuse_term, Specular_term)));
+		    _mm_store_ps(&batch.out_color[i][j], Clamp4(color));
+		}
+	    }
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                         D o t 4 ( . . . )                         *
+*                                                                   *
+\*******************************************************************/
+
+	static __m128 Dot4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+	{
+	    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                   N o r m a l i z e 4 ( . . . )                   *
+*                                                                   *
+\*******************************************************************/
+
+	// Zero vectors are left as they are
+	static void Normalize4(__m128& x, __m128& y, __m128& z)
+	{
+	    __m128 length2 = Dot4(x, y, z, x, y, z);
+
+	    // One Newton-Raphson step takes the 12 bit estimate to about 22 bits
+	    __m128 r = _mm_rsqrt_ps(length2);
+	    r = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r),
+			   _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(length2, r), r)));
+	    r = _mm_and_ps(r, _mm_cmpgt_ps(length2, _mm_setzero_ps()));
+
+	    x = _mm_mul_ps(x, r);
+	    y = _mm_mul_ps(y, r);
+	    z = _mm_mul_ps(z, r);
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                    C l a m p 4 ( _ _ m 1 2 8 )                    *
+*                                                                   *
+\*******************************************************************/
+
+	static __m128 Clamp4(__m128 value)
+	{
+	    return _mm_max_ps(_mm_min_ps(value, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*           P o w 4 ( _ _ m 1 2 8 ,   r e a l _ t y p e )           *
+*                                                                   *
+\*******************************************************************/
+
+	// Computes x^n = 2^(n * log2(x)) for x in [0, 1]. Both log2 and 2^y are
+	// polynomial approximations with a relative error below 1e-6.
+	static __m128 Pow4(__m128 x, real_type n)
+	{
+	    __m128 const one = _mm_set1_ps(1.0f);
+
+	    // pow(x, 0) = 1, also for x = 0
+	    if (n == 0)
+		return one;
+
+	    // x = m * 2^e, where m is moved into [sqrt(1/2), sqrt(2))
+	    __m128i bits = _mm_castps_si128(x);
+	    __m128i e    = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+	    __m128  m    = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+							  _mm_set1_epi32(0x3f800000)));
+	    __m128  big  = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+	    m = _mm_sub_ps(m, _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+	    e = _mm_sub_epi32(e, _mm_castps_si128(big));
+
+	    // log2(m) = 2 / ln(2) * (t + t^3 / 3 + t^5 / 5 + t^7 / 7), where t = (m - 1) / (m + 1)
+	    __m128 t  = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	    __m128 t2 = _mm_mul_ps(t, t);
+	    __m128 series = _mm_add_ps(_mm_mul_ps(t2, _mm_set1_ps(1.0f / 7.0f)), _mm_set1_ps(1.0f / 5.0f));
+	    series = _mm_add_ps(_mm_mul_ps(t2, series), _mm_set1_ps(1.0f / 3.0f));
+	    series = _mm_add_ps(_mm_mul_ps(t2, series), one);
+	    __m128 log2x = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(t, series), _mm_set1_ps(2.88539008f)),
+				      _mm_cvtepi32_ps(e));
+
+	    // 2^y = 2^i * e^(f * ln(2)), where i = round(y) and f in [-1/2, 1/2]
+	    __m128  y = _mm_mul_ps(log2x, _mm_set1_ps(n));
+	    y = _mm_max_ps(_mm_min_ps(y, _mm_set1_ps(126.0f)), _mm_set1_ps(-126.0f));
+	    __m128i i = _mm_cvtps_epi32(y);
+	    __m128  f = _mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(i)), _mm_set1_ps(0.693147181f));
+
+	    __m128 exp_f = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(1.0f / 720.0f)), _mm_set1_ps(1.0f / 120.0f));
+	    exp_f = _mm_add_ps(_mm_mul_ps(f, exp_f), _mm_set1_ps(1.0f / 24.0f));
+	    exp_f = _mm_add_ps(_mm_mul_ps(f, exp_f), _mm_set1_ps(1.0f / 6.0f));
+	    exp_f = _mm_add_ps(_mm_mul_ps(f, exp_f), _mm_set1_ps(0.5f));
+	    exp_f = _mm_add_ps(_mm_mul_ps(f, exp_f), one);
+	    exp_f = _mm_add_ps(_mm_mul_ps(f, exp_f), one);
+
+	    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+
+	    // pow(0, n) = 0 for n > 0. For n < 0 it is infinite, and log2(0) = -127
+	    // already makes the result 2^126, which is clamped like infinity
+	    __m128 result = _mm_mul_ps(exp_f, scale);
+	    if (n < 0)
+		return result;
+	    return _mm_and_ps(result, _mm_cmpgt_ps(x, _mm_setzero_ps()));
+	}
+
+#endif
     };
 
 
@@ -0,0 +1,728 @@
+#ifndef HALFSPACE_RASTERIZER_H
+#define HALFSPACE_RASTERIZER_H
+//
+// Graphics Framework.
+// Copyright (C) 2011 Department of Computer Science, University of Copenhagen
+//
+
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include "graphics/graphics.h"
+
+
+/*******************************************************************\
+*                                                                   *
+*                N a m e S p a c e   g r a p h i c s                *
+*                                                                   *
+\*******************************************************************/
+
+namespace graphics {
+
+/*******************************************************************\
+*                                                                   *
+*     M y H a l f S p a c e T r i a n g l e R a s t e r i z e r     *
+*                                                                   *
+\*******************************************************************/
+
+    // The triangle is rasterized by visiting its bounding box in blocks of
+    // block_size x block_size pixels. Each edge of the triangle defines a linear
+    // edge function which is positive on the inside of the edge, so a block can
+    // be rejected by testing its four corners only. Inside a block the edge
+    // functions are stepped incrementally, and the covered pixels are kept as a
+    // bit mask. The attributes are interpolated using barycentric coordinates,
+    // which are the edge functions divided by the area of the triangle. Since the
+    // barycentric coordinates are linear in x and y, every attribute becomes a
+    // plane equation which is set up once per triangle. The normal, world point
+    // and color are only evaluated when they are asked for, so fragments which
+    // fail the z-test only pay for the depth.
+    //
+    // The vertices are rounded to integer screen coordinates, like the
+    // MyTriangleRasterizer does, and pixels lying exactly on an edge are decided
+    // by the top-left rule, so triangles sharing an edge never draw a pixel twice.
+    //
+    // block_size must be in [1..8], such that the coverage of a block fits in 64 bits.
+
+    template<typename math_types, int block_size = 4>
+    class MyHalfSpaceTriangleRasterizer : public Rasterizer<math_types>
+    {
+    public:
+	typedef typename math_types::vector3_type vector3_type;
+	typedef typename math_types::real_type    real_type;
+
+	typedef typename Rasterizer<math_types>::fragment_span_type fragment_span_type;
+
+    public:
+
+/*******************************************************************\
+*                                                                   *
+*   M y H a l f S p a c e T r i a n g l e R a s t e r i z e r ( )   *
+*                                                                   *
+\*******************************************************************/
+
+	MyHalfSpaceTriangleRasterizer() : full_block_color(0.0, 1.0, 0.0),
+					  partial_block_color(225.0 / 255.0, 245.0 / 255.0, 6.0 / 255.0),
+					  attributes_ready(false), valid(false), Debug(false)
+	{
+	    if ((block_size < 1) || (block_size > 8)) {
+		throw std::logic_error("MyHalfSpaceTriangleRasterizer: block_size must be in [1..8]");
+	    }
+	    this->scissor(std::numeric_limits<int>::min(), std::numeric_limits<int>::min(),
+			  std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+	    this->occlusion_query(0);
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*  ~ M y H a l f S p a c e T r i a n g l e R a s t e r i z e r ( )  *
+*                                                                   *
+\*******************************************************************/
+
+	virtual ~MyHalfSpaceTriangleRasterizer()
+	{}
+
+
+/*******************************************************************\
+*                                                                   *
+*                           c l o n e ( )                           *
+*                                                                   *
+\*******************************************************************/
+
+	Rasterizer<math_types>* clone() const
+	{
+	    return new MyHalfSpaceTriangleRasterizer<math_types, block_size>(*this);
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                      s c i s s o r ( . . . )                      *
+*                                                                   *
+\*******************************************************************/
+
+	void scissor(int x_min, int y_min, int x_max, int y_max)
+	{
+	    this->scissor_x_min = x_min;
+	    this->scissor_y_min = y_min;
+	    this->scissor_x_max = x_max;
+	    this->scissor_y_max = y_max;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*              o c c l u s i o n _ q u e r y ( . . . )              *
+*                                                                   *
+\*******************************************************************/
+
+	void occlusion_query(OcclusionQuery<math_types> const* query)
+	{
+	    this->query = query;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                         i n i t ( . . . )                         *
+*                                                                   *
+\*******************************************************************/
+
+	void init( vector3_type const& in_vertex1,
+		   vector3_type const& in_normal1,
+		   vector3_type const& in_worldpoint1,
+		   vector3_type const& in_color1,
+		   vector3_type const& in_vertex2,
+		   vector3_type const& in_normal2,
+		   vector3_type const& in_worldpoint2,
+		   vector3_type const& in_color2,
+		   vector3_type const& in_vertex3,
+		   vector3_type const& in_normal3,
+		   vector3_type const& in_worldpoint3,
+		   vector3_type const& in_color3) 
+	{
+	    this->valid = false;
+
+	    // Integer screen coordinates of the vertices, kept in doubles so the
+	    // edge functions are computed exactly.
+	    double X[3] = { round(in_vertex1[1]), round(in_vertex2[1]), round(in_vertex3[1]) };
+	    double Y[3] = { round(in_vertex1[2]), round(in_vertex2[2]), round(in_vertex3[2]) };
+
+	    // Twice the signed area of the triangle
+	    double area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+
+	    // Degenerate triangles, and triangles with NaN coordinates, have no fragments
+	    if (!(area != 0.0) || !(std::fabs(area) < std::numeric_limits<double>::max())) {
+		return;
+	    }
+
+	    // Save the original parameters in counter-clockwise order
+	    int second = 1;
+	    int third  = 2;
+	    if (area < 0) {
+		std::swap(X[1], X[2]);
+		std::swap(Y[1], Y[2]);
+		std::swap(second, third);
+		area = -area;
+	    }
+	    vector3_type const* vertex[3]     = { &in_vertex1,     &in_vertex2,     &in_vertex3 };
+	    vector3_type const* normal[3]     = { &in_normal1,     &in_normal2,     &in_normal3 };
+	    vector3_type const* worldpoint[3] = { &in_worldpoint1, &in_worldpoint2, &in_worldpoint3 };
+	    vector3_type const* color[3]      = { &in_color1,      &in_color2,      &in_color3 };
+	    int order[3] = { 0, second, third };
+
+	    // The edge function of edge i goes through the two vertices opposite vertex i
+	    // E_i(x, y) = a_i * x + b_i * y + c_i, and it is positive inside the triangle.
+	    for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3;
+		int k = (i + 2) % 3;
+		double dx = X[k] - X[j];
+		double dy = Y[k] - Y[j];
+		this->edge_a[i] = -dy;
+		this->edge_b[i] =  dx;
+		this->edge_c[i] =  dy * X[j] - dx * Y[j];
+
+		// Top-left rule: pixels on a left or a top edge belong to the triangle,
+		// pixels on the other edges must have a strictly positive edge function.
+		bool top_left = (dy < 0) || ((dy == 0) && (dx < 0));
+		this->edge_bias[i] = top_left ? 0.0 : 1.0;
+	    }
+
+	    // Turn the barycentric interpolation of each attribute into a plane equation
+	    double inv_area = 1.0 / area;
+	    double values[3];
+	    for (int k = 0; k < 3; ++k) values[k] = (*vertex[order[k]])[3];
+	    this->setup_plane(DEPTH, values, inv_area);
+	    this->depth_low  = std::min(std::min(values[0], values[1]), values[2]);
+	    this->depth_high = std::max(std::max(values[0], values[1]), values[2]);
+	    for (int i = 1; i <= 3; ++i) {
+		for (int k = 0; k < 3; ++k) values[k] = (*normal[order[k]])[i];
+		this->setup_plane(NORMAL + i - 1, values, inv_area);
+		for (int k = 0; k < 3; ++k) values[k] = (*worldpoint[order[k]])[i];
+		this->setup_plane(WORLDPOINT + i - 1, values, inv_area);
+		for (int k = 0; k < 3; ++k) values[k] = (*color[order[k]])[i];
+		this->setup_plane(COLOR + i - 1, values, inv_area);
+	    }
+
+	    // The bounding box of the triangle clipped against the scissor rectangle
+	    double x_low  = std::max(std::min(std::min(X[0], X[1]), X[2]), double(this->scissor_x_min));
+	    double y_low  = std::max(std::min(std::min(Y[0], Y[1]), Y[2]), double(this->scissor_y_min));
+	    double x_high = std::min(std::max(std::max(X[0], X[1]), X[2]), double(this->scissor_x_max));
+	    double y_high = std::min(std::max(std::max(Y[0], Y[1]), Y[2]), double(this->scissor_y_max));
+	    if ((x_low > x_high) || (y_low > y_high)) {
+		return;
+	    }
+	    this->x_min = static_cast<int>(x_low);
+	    this->y_min = static_cast<int>(y_low);
+	    this->x_max = static_cast<int>(x_high);
+	    this->y_max = static_cast<int>(y_high);
+
+	    // Start in the block containing the lower left corner of the bounding box
+	    this->block_x_start = this->floor_to_block(this->x_min);
+	    this->block_x       = this->block_x_start;
+	    this->block_y       = this->floor_to_block(this->y_min);
+
+	    this->valid = true;
+	    this->setup_block();
+	    this->select_fragment();
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                         D e b u g O n ( )                         *
+*                                                                   *
+\*******************************************************************/
+
+	bool DebugOn()
+	{
+	    bool oldvalue = this->Debug;
+	    this->Debug = true;
+
+	    return oldvalue;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                        D e b u g O f f ( )                        *
+*                                                                   *
+\*******************************************************************/
+
+	bool DebugOff()
+	{
+	    bool oldvalue = this->Debug;
+	    this->Debug = false;
+
+	    return oldvalue;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                               x ( )                               *
+*                                                                   *
+\*******************************************************************/
+
+	int x() const
+	{
+	    if (!this->valid) {
+		throw std::runtime_error("MyHalfSpaceTriangleRasterizer::x(): Invalid State/Not Initialized");
+	    }
+	    return this->x_current;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                               y ( )                               *
+*                                                                   *
+\*******************************************************************/
+
+	int y() const
+	{
+	    if (!this->valid) {
+		throw std::runtime_error("MyHalfSpaceTriangleRasterizer::y(): Invalid State/Not Initialized");
+	    }
+	    return this->y_current;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                           d e p t h ( )                           *
+*                                                                   *
+\*******************************************************************/
+
+	real_type depth() const
+	{
+	    if (!this->valid) {
+		throw std::runtime_error("MyHalfSpaceTriangleRasterizer::depth(): Invalid State/Not Initialized");
+	    }
+	    return this->depth_current;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                        p o s i t i o n ( )                        *
+*                                                                   *
+\*******************************************************************/
+
+	vector3_type position() const
+	{
+	    if (!this->valid) {
+		throw std::runtime_error("MyHalfSpaceTriangleRasterizer::position(): Invalid State/Not Initialized");
+	    }
+	    this->evaluate_attributes();
+	    return this->worldpoint_current;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                          n o r m a l ( )                          *
+*                                                                   *
+\*******************************************************************/
+
+	vector3_type const& normal() const
+	{
+	    if (!this->valid) {
+		throw std::runtime_error("MyHalfSpaceTriangleRasterizer::normal(): Invalid State/Not Initialized");
+	    }
+	    this->evaluate_attributes();
+	    return this->normal_current;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                           c o l o r ( )                           *
+*                                                                   *
+\*******************************************************************/
+
+	vector3_type const& color() const
+	{
+	    if (!this->valid) {
+		throw std::runtime_error("MyHalfSpaceTriangleRasterizer::color(): Invalid State/Not Initialized");
+	    }
+	    this->evaluate_attributes();
+	    return this->color_current;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                  m o r e _ f r a g m e n t s ( )                  *
+*                                                                   *
+\*******************************************************************/
+
+	bool more_fragments() const
+	{
+	    return this->valid;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                   n e x t _ f r a g m e n t ( )                   *
+*                                                                   *
+\*******************************************************************/
+
+	void next_fragment()
+	{
+	    if (!this->valid) return;
+
+	    // Remove the current pixel from the coverage mask of the block
+	    this->block_mask &= this->block_mask - 1;
+	    this->select_fragment();
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*               n e x t _ f r a g m e n t s ( . . . )               *
+*                                                                   *
+\*******************************************************************/
+
+	// Evaluates the plane equations straight into the span, instead of
+	// going through the checked accessors one fragment at a time.
+	int next_fragments(fragment_span_type& span)
+	{
+	    span.count = 0;
+	    while (this->valid && (span.count < Rasterizer<math_types>::span_size)) {
+		int const j = span.count;
+
+		span.x[j]     = this->x_current;
+		span.y[j]     = this->y_current;
+		span.depth[j] = this->depth_current;
+		if (this->Debug) {
+		    // The color depends on the block, so the attributes are not deferred
+		    vector3_type const& color = this->block_full ? this->full_block_color : this->partial_block_color;
+		    for (int i = 0; i < 3; ++i) {
+			span.position[i][j] = static_cast<real_type>(this->evaluate_plane(WORLDPOINT + i));
+			span.normal[i][j]   = static_cast<real_type>(this->evaluate_plane(NORMAL + i));
+			span.color[i][j]    = color[i + 1];
+		    }
+		}
+
+		++span.count;
+		this->block_mask &= this->block_mask - 1;
+		this->select_fragment();
+	    }
+	    return span.count;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*             d e f e r r e d _ a t t r i b u t e s ( )             *
+*                                                                   *
+\*******************************************************************/
+
+	// The attributes are plane equations, so they can be evaluated for the
+	// fragments which pass the z-test only.
+	bool deferred_attributes() const
+	{
+	    return !this->Debug;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*       i n t e r p o l a t e _ a t t r i b u t e s ( . . . )       *
+*                                                                   *
+\*******************************************************************/
+
+	void interpolate_attributes(fragment_span_type& span) const
+	{
+	    for (int j = 0; j < span.count; ++j) {
+		double const x = span.x[j];
+		double const y = span.y[j];
+		for (int i = 0; i < 3; ++i) {
+		    span.position[i][j] = static_cast<real_type>(this->evaluate_plane(WORLDPOINT + i, x, y));
+		    span.normal[i][j]   = static_cast<real_type>(this->evaluate_plane(NORMAL + i, x, y));
+		    span.color[i][j]    = static_cast<real_type>(this->evaluate_plane(COLOR + i, x, y));
+		}
+	    }
+	}
+
+
+    private:
+
+/*******************************************************************\
+*                                                                   *
+*               f l o o r _ t o _ b l o c k ( i n t )               *
+*                                                                   *
+\*******************************************************************/
+
+	// Returns the largest multiple of block_size which is less than or equal to value
+	int floor_to_block(int value) const
+	{
+	    int remainder = value % block_size;
+	    if (remainder < 0) remainder += block_size;
+	    return value - remainder;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                     s e t u p _ b l o c k ( )                     *
+*                                                                   *
+\*******************************************************************/
+
+	// Computes the coverage mask of the current block. Bit (j * block_size + i)
+	// is set if the pixel (block_x + i, block_y + j) is inside the triangle and
+	// inside the bounding box.
+	void setup_block()
+	{
+	    this->block_mask = 0;
+	    this->block_full = true;
+
+	    double const extent = block_size - 1;
+	    double e_origin[3];
+	    for (int k = 0; k < 3; ++k) {
+		e_origin[k] = this->edge_a[k] * this->block_x + this->edge_b[k] * this->block_y
+		            + this->edge_c[k] - this->edge_bias[k];
+
+		// The edge function is linear, so its extremes are found at the corners
+		double e_x  = this->edge_a[k] * extent;
+		double e_y  = this->edge_b[k] * extent;
+		double e_max = e_origin[k] + std::max(e_x, 0.0) + std::max(e_y, 0.0);
+		double e_min = e_origin[k] + std::min(e_x, 0.0) + std::min(e_y, 0.0);
+
+		// The whole block is outside this edge, reject it
+		if (e_max < 0) {
+		    this->block_full = false;
+		    return;
+		}
+		if (e_min < 0) this->block_full = false;
+	    }
+
+	    // Reject the block if the z-buffer shows that all of its fragments are hidden.
+	    // The depths inside the triangle lie between the depths of the vertices.
+	    if (this->query != 0) {
+		// A margin for rounding errors, as the range is estimated from the corners
+		double const depth_slack = OcclusionQuery<math_types>::depth_slack();
+		double z_origin = this->plane[DEPTH][0] * this->block_x + this->plane[DEPTH][1] * this->block_y
+		                + this->plane[DEPTH][2];
+		double z_x = this->plane[DEPTH][0] * extent;
+		double z_y = this->plane[DEPTH][1] * extent;
+		double z_low  = z_origin + std::min(z_x, 0.0) + std::min(z_y, 0.0) - depth_slack;
+		double z_high = z_origin + std::max(z_x, 0.0) + std::max(z_y, 0.0) + depth_slack;
+		if (this->query->hidden(std::max(this->block_x, this->x_min),
+					std::max(this->block_y, this->y_min),
+					std::min(this->block_x + block_size - 1, this->x_max),
+					std::min(this->block_y + block_size - 1, this->y_max),
+					static_cast<real_type>(std::max(z_low,  this->depth_low)),
+					static_cast<real_type>(std::min(z_high, this->depth_high))))
+		{
+		    this->block_full = false;
+		    return;
+		}
+	    }
+
+	    bool inside_box = (this->block_x >= this->x_min) && (this->block_x + block_size - 1 <= this->x_max) &&
+		              (this->block_y >= this->y_min) && (this->block_y + block_size - 1 <= this->y_max);
+
+	    if (this->block_full && inside_box) {
+		this->block_mask = (block_size * block_size == 64)
+		    ? ~0ULL : ((1ULL << (block_size * block_size)) - 1);
+		return;
+	    }
+
+	    // Step the edge functions incrementally through the pixels of the block
+	    for (int j = 0; j < block_size; ++j) {
+		int y = this->block_y + j;
+		double e_row[3];
+		for (int k = 0; k < 3; ++k) {
+		    e_row[k] = e_origin[k] + this->edge_b[k] * j;
+		}
+		for (int i = 0; i < block_size; ++i) {
+		    int x = this->block_x + i;
+		    if ((e_row[0] >= 0) && (e_row[1] >= 0) && (e_row[2] >= 0) &&
+			(x >= this->x_min) && (x <= this->x_max) && (y >= this->y_min) && (y <= this->y_max))
+		    {
+			this->block_mask |= 1ULL << (j * block_size + i);
+		    }
+		    for (int k = 0; k < 3; ++k) {
+			e_row[k] += this->edge_a[k];
+		    }
+		}
+	    }
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                 s e l e c t _ f r a g m e n t ( )                 *
+*                                                                   *
+\*******************************************************************/
+
+	// Makes the lowest pixel in the coverage mask the current fragment. If the
+	// current block has no pixels left, the following blocks are searched.
+	void select_fragment()
+	{
+	    while (this->block_mask == 0) {
+		this->block_x += block_size;
+		if (this->block_x > this->x_max) {
+		    this->block_x  = this->block_x_start;
+		    this->block_y += block_size;
+		    if (this->block_y > this->y_max) {
+			this->valid = false;
+			return;
+		    }
+		}
+		this->setup_block();
+	    }
+
+#ifdef __GNUC__
+	    int bit = __builtin_ctzll(this->block_mask);
+#else
+	    int bit = 0;
+	    while (!(this->block_mask & (1ULL << bit))) ++bit;
+#endif
+	    this->x_current = this->block_x + bit % block_size;
+	    this->y_current = this->block_y + bit / block_size;
+
+	    this->depth_current = static_cast<real_type>(this->evaluate_plane(DEPTH));
+	    this->attributes_ready = false;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                  s e t u p _ p l a n e ( . . . )                  *
+*                                                                   *
+\*******************************************************************/
+
+	// Sets up the plane equation of an attribute from its values at the three
+	// vertices: value(x, y) = dx * x + dy * y + constant
+	void setup_plane(int channel, double const values[3], double inv_area)
+	{
+	    double dx = 0.0, dy = 0.0, constant = 0.0;
+	    for (int k = 0; k < 3; ++k) {
+		dx       += this->edge_a[k] * values[k];
+		dy       += this->edge_b[k] * values[k];
+		constant += this->edge_c[k] * values[k];
+	    }
+	    this->plane[channel][0] = dx       * inv_area;
+	    this->plane[channel][1] = dy       * inv_area;
+	    this->plane[channel][2] = constant * inv_area;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*               e v a l u a t e _ p l a n e ( i n t )               *
+*                                                                   *
+\*******************************************************************/
+
+	double evaluate_plane(int channel) const
+	{
+	    return this->evaluate_plane(channel, this->x_current, this->y_current);
+	}
+
+	double evaluate_plane(int channel, double x, double y) const
+	{
+	    return this->plane[channel][0] * x
+		 + this->plane[channel][1] * y
+		 + this->plane[channel][2];
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*             e v a l u a t e _ a t t r i b u t e s ( )             *
+*                                                                   *
+\*******************************************************************/
+
+	// Computes the normal, world point and color of the current fragment,
+	// the first time one of them is asked for.
+	void evaluate_attributes() const
+	{
+	    if (this->attributes_ready) return;
+
+	    for (int i = 0; i < 3; ++i) {
+		this->normal_current[i + 1]     = this->evaluate_plane(NORMAL + i);
+		this->worldpoint_current[i + 1] = this->evaluate_plane(WORLDPOINT + i);
+	    }
+	    if (this->Debug) {
+		// Fully covered blocks are green, partially covered blocks are yellow
+		this->color_current = this->block_full ? this->full_block_color : this->partial_block_color;
+	    }
+	    else {
+		for (int i = 0; i < 3; ++i) {
+		    this->color_current[i + 1] = this->evaluate_plane(COLOR + i);
+		}
+	    }
+	    this->attributes_ready = true;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                 P r i v a t e   V a r i a b l e s                 *
+*                                                                   *
+\*******************************************************************/
+
+	// The interpolated attributes, each component has its own plane equation
+	enum { DEPTH = 0, NORMAL = 1, WORLDPOINT = 4, COLOR = 7, CHANNELS = 10 };
+	double plane[CHANNELS][3];
+
+	// The edge functions and the top-left bias of each edge
+	double edge_a[3];
+	double edge_b[3];
+	double edge_c[3];
+	double edge_bias[3];
+
+	// The range of the depths of the vertices
+	double depth_low;
+	double depth_high;
+
+	// The z-buffer to ask which blocks are hidden, 0 if there is none
+	OcclusionQuery<math_types> const* query;
+
+	// The scissor rectangle
+	int scissor_x_min;
+	int scissor_y_min;
+	int scissor_x_max;
+	int scissor_y_max;
+
+	// The bounding box of the triangle, clipped against the scissor rectangle
+	int x_min;
+	int y_min;
+	int x_max;
+	int y_max;
+
+	// The current block and its coverage
+	int                block_x_start;
+	int                block_x;
+	int                block_y;
+	unsigned long long block_mask;
+	bool               block_full;
+
+	// The colors used in Debug mode
+	vector3_type full_block_color;
+	vector3_type partial_block_color;
+
+	// The current fragment
+	int                  x_current;
+	int                  y_current;
+	real_type            depth_current;
+	mutable vector3_type normal_current;
+	mutable vector3_type worldpoint_current;
+	mutable vector3_type color_current;
+	mutable bool         attributes_ready;
+
+	bool valid;
+	bool Debug;
+    };
+
+}// end namespace graphics
+
+// HALFSPACE_RASTERIZER_H
+#endif
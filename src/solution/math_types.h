@@ -5,6 +5,8 @@
 // Copyright (C) 2007 Department of Computer Science, University of Copenhagen
 //
 
+#include <type_traits>
+
 #define INSTANTIATE
 #  include <matrix/matrix.h>
 #undef INSTANTIATE
@@ -24,6 +26,7 @@ namespace graphics {
       typedef RowVector<real_type,3>        vector3row_type;
       typedef RowVector<real_type,4>        vector4row_type;
 
+      typedef Matrix<real_type, 3, 3>       matrix3x3_type;
       typedef Matrix<real_type, 4, 4>       matrix4x4_type;
 
       typedef RowVector<vector3_type, 4>    bezier_curve;
@@ -36,6 +39,17 @@ namespace graphics {
       typedef Matrix<vector3_type, 4, 4>	matrixfwd_type;
   };
 
+  // The math types are plain data, which can be copied with memcpy and
+  // packed into vertex buffers
+  static_assert(std::is_trivially_copyable<MyMathTypes::vector3_type>::value, "vector3_type has to be trivially copyable");
+  static_assert(std::is_trivially_copyable<MyMathTypes::matrix4x4_type>::value, "matrix4x4_type has to be trivially copyable");
+  static_assert(std::is_standard_layout<MyMathTypes::vector3_type>::value, "vector3_type has to be standard layout");
+  static_assert(std::is_standard_layout<MyMathTypes::matrix4x4_type>::value, "matrix4x4_type has to be standard layout");
+  static_assert(sizeof(MyMathTypes::vector3_type) == 16 && alignof(MyMathTypes::vector3_type) == 16,
+		"vector3_type has to fill an SSE register");
+  static_assert(sizeof(MyMathTypes::matrix4x4_type) == 64 && alignof(MyMathTypes::matrix4x4_type) == 16,
+		"matrix4x4_type has to be 64 contiguous bytes");
+
 
 /*******************************************************************\
 *                                                                   *
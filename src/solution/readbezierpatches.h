@@ -9,9 +9,18 @@
 
 #include <fstream>
 #include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "solution/binarypatches.h"
 
 namespace graphics {
 
@@ -255,6 +264,65 @@ namespace graphics {
 	return 0;
     }
 
+
+/*******************************************************************\
+*                                                                   *
+*                 L o a d B e z i e r P a t c h e s                 *
+*                                                                   *
+\*******************************************************************/
+
+    /**
+     * A set of Bezier patches which is shared by everybody who loads the
+     * same file, and must therefore not be modified.
+     */
+    typedef std::shared_ptr<std::vector<graphics::MyMathTypes::bezier_patch> const> BezierPatchSet;
+
+    /**
+     * Load Bezier Patches.
+     * Like ReadBezierPatches, but the patches of every file are kept in a
+     * cache, keyed by the name of the file. The file is only read again if
+     * its modification time or size has changed since it was read, so
+     * drawing the same patches over and over costs a call to stat().
+     * Files ending in .bpatch are read with ReadBinaryBezierPatches.
+     *
+     * @param filename  The name of the file with the patches.
+     * @return the patches, or an empty pointer if the file cannot be read.
+     */
+    inline BezierPatchSet LoadBezierPatches(const char* filename)
+    {
+	struct CacheEntry
+	{
+	    std::time_t    modified;
+	    long long      size;
+	    BezierPatchSet patches;
+	};
+	static std::map<std::string, CacheEntry> cache;
+	static std::mutex                        cache_mutex;
+
+	struct stat status;
+	if (stat(filename, &status) != 0) {
+	    std::cerr << "Cannot open data file: " << filename << std::endl << std::flush;
+	    return BezierPatchSet();
+	}
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	CacheEntry& entry = cache[filename];
+	if (!entry.patches || (entry.modified != status.st_mtime) || (entry.size != status.st_size)) {
+	    std::shared_ptr<std::vector<graphics::MyMathTypes::bezier_patch> > patches(
+		new std::vector<graphics::MyMathTypes::bezier_patch>());
+	    std::string name(filename);
+	    bool binary = (name.size() > 7) && (name.compare(name.size() - 7, 7, ".bpatch") == 0);
+	    if ((binary ? ReadBinaryBezierPatches(filename, *patches) : ReadBezierPatches(filename, *patches)) != 0) {
+		cache.erase(filename);
+		return BezierPatchSet();
+	    }
+	    entry.modified = status.st_mtime;
+	    entry.size     = status.st_size;
+	    entry.patches  = patches;
+	}
+	return entry.patches;
+    }
+
 }
 
 #endif
@@ -0,0 +1,302 @@
+#ifndef SURFACEMESH_H
+#define SURFACEMESH_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+
+#include "solution/math_types.h"
+
+
+/*******************************************************************\
+*                                                                   *
+*                      S u r f a c e M e s h                        *
+*                                                                   *
+\*******************************************************************/
+
+/**
+ * A Surface Mesh.
+ * A parametric surface evaluated once at every point of a (u, v) grid.
+ * Neighbouring quads share the grid points, and every quad is split into
+ * two triangles which index them, ready for draw_indexed_triangles.
+ *
+ * The grid points are independent of each other, so large grids are
+ * evaluated by a pool of threads which each take one row of the grid, i.e.
+ * one value of u, at a time, and write straight into the vertex and normal
+ * buffers, which are allocated up front. The surface must therefore allow
+ * being evaluated by several threads at once.
+ */
+template<typename math_types>
+class SurfaceMesh {
+public:
+    typedef typename math_types::real_type    real_type;
+    typedef typename math_types::vector3_type vector3_type;
+
+    /// Grids with fewer points per thread than this are evaluated by fewer threads.
+    enum { min_points_per_thread = 1024 };
+
+    /**
+     * The parameter range of a surface. The grid points are generated
+     * like the loop
+     *
+     *     for (u = u_start; u < u_stop; u += delta_u)
+     *
+     * generates them, including its rounding errors, plus one more point
+     * at the far end, and the same for v.
+     */
+    struct grid_type
+    {
+	real_type u_start;
+	real_type delta_u;
+	real_type u_stop;
+	real_type v_start;
+	real_type delta_v;
+	real_type v_stop;
+
+	bool operator<(grid_type const& other) const
+	{
+	    real_type const a[6] = { u_start, delta_u, u_stop, v_start, delta_v, v_stop };
+	    real_type const b[6] = { other.u_start, other.delta_u, other.u_stop,
+				     other.v_start, other.delta_v, other.v_stop };
+	    for (int i = 0; i < 6; ++i) {
+		if (a[i] != b[i]) return a[i] < b[i];
+	    }
+	    return false;
+	}
+    };
+
+public:
+    /**
+     * Tessellate a Surface.
+     * The quad at (u, v) is split into the triangles (u, v), (u + delta_u, v),
+     * (u + delta_u, v + delta_v) and (u, v), (u + delta_u, v + delta_v), (u, v + delta_v),
+     * and the quads are ordered with u in the outer loop.
+     *
+     * @param surface  Computes the vertex and the normal at (u, v) with
+     *                 surface(u, v, vertex, normal).
+     * @param grid     The parameter range.
+     * @param color    The color of every vertex.
+     * @param thread_count  The largest number of threads to use. If it is 0 the
+     *                      number of hardware threads is used.
+     */
+    template<typename surface_type>
+    void tessellate(surface_type const& surface, grid_type const& grid, vector3_type const& color,
+		    int thread_count = 0)
+    {
+	std::vector<real_type> u_values;
+	for (real_type u = grid.u_start; u < grid.u_stop; u += grid.delta_u)
+	    u_values.push_back(u);
+	std::vector<real_type> v_values;
+	for (real_type v = grid.v_start; v < grid.v_stop; v += grid.delta_v)
+	    v_values.push_back(v);
+
+	this->m_vertices.clear();
+	this->m_normals.clear();
+	this->m_indices.clear();
+	if (u_values.empty() || v_values.empty()) {
+	    this->m_colors.clear();
+	    return;
+	}
+	u_values.push_back(u_values.back() + grid.delta_u);
+	v_values.push_back(v_values.back() + grid.delta_v);
+
+	int rows    = static_cast<int>(u_values.size());
+	int columns = static_cast<int>(v_values.size());
+	this->m_vertices.resize(rows * columns);
+	this->m_normals.resize(rows * columns);
+	this->m_colors.assign(rows * columns, color);
+
+	if (thread_count <= 0)
+	    thread_count = static_cast<int>(std::thread::hardware_concurrency());
+	thread_count = std::min(thread_count, rows * columns / min_points_per_thread);
+	thread_count = std::max(thread_count, 1);
+
+	std::atomic<int>         next_row(0);
+	std::vector<std::string> errors(thread_count);
+	std::vector<std::thread> workers;
+	try {
+	    for (int i = 1; i < thread_count; ++i) {
+		workers.push_back(std::thread(&SurfaceMesh::evaluate_rows<surface_type>, this,
+					      std::cref(surface), std::cref(u_values), std::cref(v_values),
+					      std::ref(next_row), std::ref(errors[i])));
+	    }
+	    //--- The calling thread does its share of the work as well
+	    this->evaluate_rows(surface, u_values, v_values, next_row, errors[0]);
+	}
+	catch (...) {
+	    //--- A thread could not be started, so the running ones are stopped and joined
+	    next_row = rows;
+	    for (int i = 0; i < static_cast<int>(workers.size()); ++i)
+		workers[i].join();
+	    throw;
+	}
+
+	for (int i = 0; i < static_cast<int>(workers.size()); ++i)
+	    workers[i].join();
+
+	for (int i = 0; i < thread_count; ++i) {
+	    if (!errors[i].empty())
+		throw std::runtime_error("SurfaceMesh::tessellate(): " + errors[i]);
+	}
+
+	this->m_indices.reserve(6 * (u_values.size() - 1) * (v_values.size() - 1));
+	for (int i = 0; i + 1 < static_cast<int>(u_values.size()); ++i) {
+	    for (int j = 0; j + 1 < columns; ++j) {
+		int v_11 = i * columns + j;         // (u, v)
+		int v_12 = v_11 + columns;          // (u + delta_u, v)
+		int v_21 = v_11 + 1;                // (u, v + delta_v)
+		int v_22 = v_12 + 1;                // (u + delta_u, v + delta_v)
+
+		this->m_indices.push_back(v_11);
+		this->m_indices.push_back(v_12);
+		this->m_indices.push_back(v_22);
+
+		this->m_indices.push_back(v_11);
+		this->m_indices.push_back(v_22);
+		this->m_indices.push_back(v_21);
+	    }
+	}
+    }
+
+    std::vector<vector3_type> const& vertices() const { return this->m_vertices; }
+    std::vector<vector3_type> const& normals()  const { return this->m_normals; }
+    std::vector<vector3_type> const& colors()   const { return this->m_colors; }
+    std::vector<int>          const& indices()  const { return this->m_indices; }
+
+protected:
+    /**
+     * Evaluate the surface at the grid points of one row after the other,
+     * until all rows are taken. Runs on every thread of tessellate.
+     *
+     * @param next_row  The next row which no thread has taken yet.
+     * @param error     The message of an exception thrown by the surface, if any.
+     *                  Nothing is thrown out of it, since it runs on the workers.
+     */
+    template<typename surface_type>
+    void evaluate_rows(surface_type const& surface,
+		       std::vector<real_type> const& u_values, std::vector<real_type> const& v_values,
+		       std::atomic<int>& next_row, std::string& error)
+    {
+	int rows    = static_cast<int>(u_values.size());
+	int columns = static_cast<int>(v_values.size());
+	try {
+	    for (int i = next_row++; i < rows; i = next_row++) {
+		for (int j = 0; j < columns; ++j) {
+		    surface(u_values[i], v_values[j], this->m_vertices[i * columns + j], this->m_normals[i * columns + j]);
+		}
+	    }
+	}
+	catch (std::exception const& exception) {
+	    error = exception.what();
+	    next_row = rows;
+	}
+	catch (...) {
+	    //--- Anything else would terminate a worker thread
+	    error = "unknown exception";
+	    next_row = rows;
+	}
+    }
+
+private:
+    std::vector<vector3_type> m_vertices;
+    std::vector<vector3_type> m_normals;
+    std::vector<vector3_type> m_colors;
+    std::vector<int>          m_indices;
+};
+
+
+/*******************************************************************\
+*                                                                   *
+*                 S u r f a c e M e s h C a c h e                   *
+*                                                                   *
+\*******************************************************************/
+
+/**
+ * A Surface Mesh Cache.
+ * Keeps a SurfaceMesh for every surface and parameter range it has been
+ * asked for, such that a surface drawn in every frame is only evaluated
+ * once. A mesh is tessellated again only if the parameters of the surface
+ * or the color have changed since.
+ */
+template<typename math_types>
+class SurfaceMeshCache {
+public:
+    typedef typename math_types::real_type         real_type;
+    typedef typename math_types::vector3_type      vector3_type;
+    typedef SurfaceMesh<math_types>                mesh_type;
+    typedef typename mesh_type::grid_type          grid_type;
+
+public:
+    SurfaceMeshCache() : m_thread_count(0)
+    {}
+
+    /**
+     * Set the largest number of threads which tessellate a mesh.
+     *
+     * @param thread_count  The number of threads. If it is 0 the number of
+     *                      hardware threads is used.
+     */
+    void set_thread_count(int thread_count)
+    {
+	this->m_thread_count = thread_count;
+    }
+
+    /**
+     * Get a Surface Mesh.
+     *
+     * @param name        Tells the surfaces apart.
+     * @param surface     The surface, see SurfaceMesh::tessellate.
+     * @param grid        The parameter range.
+     * @param parameters  The parameters of the surface which the mesh depends on.
+     * @param color       The color of every vertex.
+     *
+     * @return the mesh, which stays valid until the next call with the same name and grid.
+     */
+    template<typename surface_type>
+    mesh_type const& mesh(std::string const& name, surface_type const& surface, grid_type const& grid,
+			  std::vector<real_type> const& parameters, vector3_type const& color)
+    {
+	entry_type& entry = this->m_entries[std::make_pair(name, grid)];
+	bool valid = entry.tessellated && (entry.parameters == parameters);
+	for (int i = 1; valid && (i <= 3); ++i)
+	    valid = (entry.color[i] == color[i]);
+
+	if (!valid) {
+	    entry.mesh.tessellate(surface, grid, color, this->m_thread_count);
+	    entry.parameters   = parameters;
+	    entry.color        = color;
+	    entry.tessellated  = true;
+	}
+	return entry.mesh;
+    }
+
+    /**
+     * Forget all meshes.
+     */
+    void clear()
+    {
+	this->m_entries.clear();
+    }
+
+private:
+    struct entry_type
+    {
+	entry_type() : tessellated(false)
+	{}
+
+	mesh_type              mesh;
+	std::vector<real_type> parameters;
+	vector3_type           color;
+	bool                   tessellated;
+    };
+
+    std::map<std::pair<std::string, grid_type>, entry_type> m_entries;
+    int                                                     m_thread_count;
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <iomanip>
 #include <stdexcept>
+#include <limits>
 #include <cmath>
 #include "graphics/graphics.h"
 #include "solution/edge_rasterizer.h"
@@ -27,6 +28,8 @@ namespace graphics {
 	typedef typename math_types::vector3_type vector3_type;
 	typedef typename math_types::real_type    real_type;
 
+	typedef typename Rasterizer<math_types>::fragment_span_type fragment_span_type;
+
 
     public:
 
@@ -37,8 +40,10 @@ namespace graphics {
 *                                                                   *
 \*******************************************************************/
 
-	MyTriangleRasterizer() : valid(false), Debug(false)
+	MyTriangleRasterizer() : valid(false), Debug(false), EarlyDepth(false)
 	{
+	    this->scissor(std::numeric_limits<int>::min(), std::numeric_limits<int>::min(),
+			  std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
 	    //std::cout << "-->MyTriangleRasterizer" << std::endl;
 	    //std::cout << "<--MyTriangleRasterizer" << std::endl;
 	}
@@ -105,6 +110,9 @@ namespace graphics {
 	    }
 	    else {
 		//std::cout << "MyTriangleRasterizer::init(...): Triangle not degenerate" << std::endl;
+		if (this->EarlyDepth) {
+		    this->initialize_barycentrics();
+		}
 		this->initialize_triangle();
 	    }
 //	    this->Debug = false;
@@ -112,6 +120,36 @@ namespace graphics {
 	}
 
 
+/*******************************************************************\
+*                                                                   *
+*                      s c i s s o r ( . . . )                      *
+*                                                                   *
+\*******************************************************************/
+
+	// Only the fragments inside the rectangle are generated. The scanlines
+	// are still walked from the bottom of the triangle, so the fragments
+	// inside are exactly the same as without the rectangle.
+	void scissor(int x_min, int y_min, int x_max, int y_max)
+	{
+	    this->scissor_x_min = x_min;
+	    this->scissor_y_min = y_min;
+	    this->scissor_x_max = x_max;
+	    this->scissor_y_max = y_max;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                           c l o n e ( )                           *
+*                                                                   *
+\*******************************************************************/
+
+	Rasterizer<math_types>* clone() const
+	{
+	    return new MyTriangleRasterizer<math_types>(*this);
+	}
+
+
 /*******************************************************************\
 *                                                                   *
 *                         D e b u g O n ( )                         *
@@ -142,6 +180,53 @@ namespace graphics {
 	}
 
 
+/*******************************************************************\
+*                                                                   *
+*                    E a r l y D e p t h O n ( )                    *
+*                                                                   *
+\*******************************************************************/
+
+	// Only the depth is interpolated along the scanlines. The normal, world
+	// point and color are computed from barycentric coordinates when they
+	// are asked for, so the render pipeline can skip them for the fragments
+	// which fail the z-test. Takes effect from the next call of init().
+	bool EarlyDepthOn()
+	{
+	    bool oldvalue = this->EarlyDepth;
+	    this->EarlyDepth = true;
+
+	    return oldvalue;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                   E a r l y D e p t h O f f ( )                   *
+*                                                                   *
+\*******************************************************************/
+
+	bool EarlyDepthOff()
+	{
+	    bool oldvalue = this->EarlyDepth;
+	    this->EarlyDepth = false;
+
+	    return oldvalue;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*             d e f e r r e d _ a t t r i b u t e s ( )             *
+*                                                                   *
+\*******************************************************************/
+
+	// In Debug mode the color depends on the scanline, so it is not deferred.
+	bool deferred_attributes() const
+	{
+	    return this->EarlyDepth && !this->Debug;
+	}
+
+
 /*******************************************************************\
 *                                                                   *
 *                           V a l i d ( )                           *
@@ -227,6 +312,10 @@ namespace graphics {
                 throw std::runtime_error("MyTriangleRasterizer::position(): Invalid State/Not Initialized");
             }
 	    //return vector3_type(this->x(), this->y(), this->depth());
+	    if (this->EarlyDepth) {
+		this->interpolate_fragment(this->x_current, this->y_current);
+		return this->lazy_worldpoint;
+	    }
 	    if (!this->worldpoint_interpolator.more_values()) {
 		throw std::runtime_error("MyEdgeRasterizer::position(): Invalid worldpoint_interpolator");
 	    }
@@ -246,6 +335,10 @@ namespace graphics {
                 throw std::runtime_error("MyTriangleRasterizer::normal(): Invalid State/Not Iitialized");
             }
 	    //return this->Ncurrent;
+	    if (this->EarlyDepth) {
+		this->interpolate_fragment(this->x_current, this->y_current);
+		return this->lazy_normal;
+	    }
 	    if (!this->normal_interpolator.more_values()) {
 		throw std::runtime_error("MyTriangleRasterizer::normal(): Invalid normal_interpolator");
 	    }
@@ -270,6 +363,10 @@ namespace graphics {
 		return this->color_current;
 	    }
 
+	    if (this->EarlyDepth) {
+		this->interpolate_fragment(this->x_current, this->y_current);
+		return this->lazy_color;
+	    }
 	    if (!this->color_interpolator.more_values()) {
 		throw std::runtime_error("MyEdgeRasterizer::color(): Invalid color_interpolator");
 	    }
@@ -333,17 +430,16 @@ namespace graphics {
 	{
 	    // The new algorithm - and it does work for horizontal bottom lines!
 
-	    if (this->x_current < this->x_stop) {
-		this->x_current += 1;
-
-		this->depth_interpolator.next_value();
-		this->normal_interpolator.next_value();
-		this->worldpoint_interpolator.next_value();
-		this->color_interpolator.next_value();
+	    if ((this->x_current < this->x_stop) && (this->x_current < this->scissor_x_max)) {
+		this->step_fragment();
 	    }
 	    else {
 		// this->x_current >= this->x_stop, so find the next NonEmptyScanline
 		this->valid = this->SearchForNonEmptyScanline();
+		if (this->valid && !this->scissor_scanline()) {
+		    this->next_scissored_scanline();
+		    return;
+		}
 	    }
 // This must be changed
 	    if (this->Debug) {
@@ -359,6 +455,72 @@ namespace graphics {
 	}
 
 
+/*******************************************************************\
+*                                                                   *
+*               n e x t _ f r a g m e n t s ( . . . )               *
+*                                                                   *
+\*******************************************************************/
+
+	// Copies the interpolated values straight into the span, instead of
+	// going through the checked accessors one fragment at a time.
+	int next_fragments(fragment_span_type& span)
+	{
+	    span.count = 0;
+	    while (this->valid && (span.count < Rasterizer<math_types>::span_size)) {
+		int const j = span.count;
+
+		span.x[j]     = this->x_current;
+		span.y[j]     = this->y_current;
+		span.depth[j] = this->depth_interpolator.value();
+
+		if (!this->EarlyDepth) {
+		    vector3_type const& position = this->worldpoint_interpolator.value();
+		    vector3_type const& normal   = this->normal_interpolator.value();
+		    vector3_type const& color    = this->Debug ? this->color_current : this->color_interpolator.value();
+		    for (int i = 0; i < 3; ++i) {
+			span.position[i][j] = position[i + 1];
+			span.normal[i][j]   = normal[i + 1];
+			span.color[i][j]    = color[i + 1];
+		    }
+		}
+		else if (this->Debug) {
+		    // The attributes are not deferred in Debug mode, see deferred_attributes()
+		    this->interpolate_fragment(this->x_current, this->y_current);
+		    for (int i = 0; i < 3; ++i) {
+			span.position[i][j] = this->lazy_worldpoint[i + 1];
+			span.normal[i][j]   = this->lazy_normal[i + 1];
+			span.color[i][j]    = this->color_current[i + 1];
+		    }
+		}
+
+		++span.count;
+		this->MyTriangleRasterizer<math_types>::next_fragment();
+	    }
+	    return span.count;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*       i n t e r p o l a t e _ a t t r i b u t e s ( . . . )       *
+*                                                                   *
+\*******************************************************************/
+
+	// Computes the normal, world point and color of the fragments which
+	// passed the z-test, when the rasterizer is in EarlyDepth mode.
+	void interpolate_attributes(fragment_span_type& span) const
+	{
+	    for (int j = 0; j < span.count; ++j) {
+		this->interpolate_fragment(span.x[j], span.y[j]);
+		for (int i = 0; i < 3; ++i) {
+		    span.position[i][j] = this->lazy_worldpoint[i + 1];
+		    span.normal[i][j]   = this->lazy_normal[i + 1];
+		    span.color[i][j]    = this->lazy_color[i + 1];
+		}
+	    }
+	}
+
+
 
     private:
 
@@ -508,17 +670,20 @@ namespace graphics {
 	    this->depth_interpolator.init(this->x_start, this->x_stop,
 	    				  this->leftedge.depth(), this->rightedge.depth());
 
-            // Normal Interpolator
-	    this->normal_interpolator.init(this->x_start, this->x_stop,
-	    				   this->leftedge.normal(),  this->rightedge.normal());
+	    // In EarlyDepth mode the other attributes come from the barycentric coordinates
+	    if (!this->EarlyDepth) {
+		// Normal Interpolator
+		this->normal_interpolator.init(this->x_start, this->x_stop,
+					       this->leftedge.normal(),  this->rightedge.normal());
 
-	    // World Point Interpolator
-	    this->worldpoint_interpolator.init(this->x_start, this->x_stop,
-	    				       this->leftedge.position(), this->rightedge.position());
+		// World Point Interpolator
+		this->worldpoint_interpolator.init(this->x_start, this->x_stop,
+						   this->leftedge.position(), this->rightedge.position());
 
-            // Color Interpolator
-	    this->color_interpolator.init(this->x_start, this->x_stop,
-	    				  this->leftedge.color(), this->rightedge.color());
+		// Color Interpolator
+		this->color_interpolator.init(this->x_start, this->x_stop,
+					      this->leftedge.color(), this->rightedge.color());
+	    }
 
 
 
@@ -539,9 +704,82 @@ namespace graphics {
 		// Should only be called if the scanline is empty
 		this->valid = this->SearchForNonEmptyScanline();
 	    }
+
+	    if (this->valid && !this->scissor_scanline())
+		this->next_scissored_scanline();
 	    //std::cout << "<--MyTriangleRasterizer::initialize_triangle()" << std::endl;
 	}
 
+
+/*******************************************************************\
+*                                                                   *
+*                    s t e p _ f r a g m e n t ( )                  *
+*                                                                   *
+\*******************************************************************/
+
+	// Moves one fragment to the right along the current scanline
+	void step_fragment()
+	{
+	    this->x_current += 1;
+
+	    this->depth_interpolator.next_value();
+	    if (!this->EarlyDepth) {
+		this->normal_interpolator.next_value();
+		this->worldpoint_interpolator.next_value();
+		this->color_interpolator.next_value();
+	    }
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*                 s c i s s o r _ s c a n l i n e ( )               *
+*                                                                   *
+\*******************************************************************/
+
+	// Moves to the first fragment of the current scanline which is inside the
+	// scissor rectangle. The interpolators are stepped over the fragments to
+	// the left of it, so they take on the same values as without the rectangle.
+	// Returns false if no fragment of the scanline is inside the rectangle.
+	bool scissor_scanline()
+	{
+	    if ((this->y_current < this->scissor_y_min) || (this->y_current > this->scissor_y_max) ||
+		(this->x_current > this->scissor_x_max))
+		return false;
+
+	    while (this->x_current < this->scissor_x_min) {
+		if (this->x_current >= this->x_stop)
+		    return false;
+		this->step_fragment();
+	    }
+	    return true;
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*         n e x t _ s c i s s o r e d _ s c a n l i n e ( )         *
+*                                                                   *
+\*******************************************************************/
+
+	// Skips the scanlines which have no fragments inside the scissor rectangle.
+	// The scanlines go upwards, so the triangle is done above the rectangle.
+	void next_scissored_scanline()
+	{
+	    do {
+		if (this->y_current > this->scissor_y_max) {
+		    this->valid = false;
+		    return;
+		}
+		this->valid = this->SearchForNonEmptyScanline();
+	    } while (this->valid && !this->scissor_scanline());
+
+	    if (this->Debug)
+		this->choose_color(this->x_current);
+	    else
+		this->color_current = this->org_color[0];
+	}
+
 /*******************************************************************\
 *                                                                   *
 *                      d e g e n e r a t e ( )                      *
@@ -745,18 +983,20 @@ namespace graphics {
 		    this->depth_interpolator.init(this->x_start, this->x_stop,
 		    				  this->leftedge.depth(), this->rightedge.depth());
 
-		    // Normal Interpolator
-		    //std::cout << "Now the normals" << std::endl;
-		    this->normal_interpolator.init(this->x_start, this->x_stop,
-		    				   this->leftedge.normal(),  this->rightedge.normal());
+		    if (!this->EarlyDepth) {
+			// Normal Interpolator
+			//std::cout << "Now the normals" << std::endl;
+			this->normal_interpolator.init(this->x_start, this->x_stop,
+						       this->leftedge.normal(),  this->rightedge.normal());
 
-		    // World Point Interpolator
-		    this->worldpoint_interpolator.init(this->x_start, this->x_stop,
-		    				       this->leftedge.position(), this->rightedge.position());
+			// World Point Interpolator
+			this->worldpoint_interpolator.init(this->x_start, this->x_stop,
+							   this->leftedge.position(), this->rightedge.position());
 
-		    // Color Interpolator
-		    this->color_interpolator.init(this->x_start, this->x_stop,
-		    				  this->leftedge.color(), this->rightedge.color());
+			// Color Interpolator
+			this->color_interpolator.init(this->x_start, this->x_stop,
+						      this->leftedge.color(), this->rightedge.color());
+		    }
 
 		    this->valid = true;
 		}
@@ -801,6 +1041,71 @@ namespace graphics {
 	}
 
 
+/*******************************************************************\
+*                                                                   *
+*         i n i t i a l i z e _ b a r y c e n t r i c s ( )         *
+*                                                                   *
+\*******************************************************************/
+
+	// Sets up the barycentric coordinates of the second and third vertex as
+	// plane equations in the pixel coordinates. The vertices are rounded like
+	// the edges are, and the triangle is not degenerate, so the area is not zero.
+	void initialize_barycentrics()
+	{
+	    double x0 = round(this->org_vertex[0][1]);
+	    double y0 = round(this->org_vertex[0][2]);
+	    double e1x = round(this->org_vertex[1][1]) - x0;
+	    double e1y = round(this->org_vertex[1][2]) - y0;
+	    double e2x = round(this->org_vertex[2][1]) - x0;
+	    double e2y = round(this->org_vertex[2][2]) - y0;
+
+	    double inv_area = 1.0 / (e1x * e2y - e1y * e2x);
+
+	    // lambda1 = ((x - x0) * e2y - (y - y0) * e2x) / area
+	    this->barycentric[0][0] =  e2y * inv_area;
+	    this->barycentric[0][1] = -e2x * inv_area;
+	    this->barycentric[0][2] = (y0 * e2x - x0 * e2y) * inv_area;
+
+	    // lambda2 = ((y - y0) * e1x - (x - x0) * e1y) / area
+	    this->barycentric[1][0] = -e1y * inv_area;
+	    this->barycentric[1][1] =  e1x * inv_area;
+	    this->barycentric[1][2] = (x0 * e1y - y0 * e1x) * inv_area;
+
+	    for (int k = 0; k < 2; ++k) {
+		this->normal_delta[k]     = this->org_normal[k + 1]     - this->org_normal[0];
+		this->worldpoint_delta[k] = this->org_worldpoint[k + 1] - this->org_worldpoint[0];
+		this->color_delta[k]      = this->org_color[k + 1]      - this->org_color[0];
+	    }
+	}
+
+
+/*******************************************************************\
+*                                                                   *
+*i n t e r p o l a t e _ f r a g m e n t ( i n t   x ,   i n t   y )*
+*                                                                   *
+\*******************************************************************/
+
+	// Computes the normal, world point and color at a pixel from its
+	// barycentric coordinates, and stores them in the lazy_ variables.
+	void interpolate_fragment(int x, int y) const
+	{
+	    real_type lambda1 = static_cast<real_type>(this->barycentric[0][0] * x
+						      + this->barycentric[0][1] * y
+						      + this->barycentric[0][2]);
+	    real_type lambda2 = static_cast<real_type>(this->barycentric[1][0] * x
+						      + this->barycentric[1][1] * y
+						      + this->barycentric[1][2]);
+	    for (int i = 1; i <= 3; ++i) {
+		this->lazy_normal[i]     = this->org_normal[0][i]
+		                         + lambda1 * this->normal_delta[0][i]     + lambda2 * this->normal_delta[1][i];
+		this->lazy_worldpoint[i] = this->org_worldpoint[0][i]
+		                         + lambda1 * this->worldpoint_delta[0][i] + lambda2 * this->worldpoint_delta[1][i];
+		this->lazy_color[i]      = this->org_color[0][i]
+		                         + lambda1 * this->color_delta[0][i]      + lambda2 * this->color_delta[1][i];
+	    }
+	}
+
+
 /*******************************************************************\
 *                                                                   *
 *               c h o o s e _ c o l o r ( i n t   x )               *
@@ -838,6 +1143,28 @@ namespace graphics {
 	// The Debug variable
 	bool Debug;
 
+	// Only interpolate the depth along the scanlines, see EarlyDepthOn()
+	bool EarlyDepth;
+
+	// The scissor rectangle, see scissor()
+	int scissor_x_min;
+	int scissor_y_min;
+	int scissor_x_max;
+	int scissor_y_max;
+
+	// The barycentric coordinates of the second and third vertex as plane equations
+	double barycentric[2][3];
+
+	// The attributes of the second and third vertex relative to the first
+	vector3_type normal_delta[2];
+	vector3_type worldpoint_delta[2];
+	vector3_type color_delta[2];
+
+	// The attributes of the last fragment passed to interpolate_fragment()
+	mutable vector3_type lazy_normal;
+	mutable vector3_type lazy_worldpoint;
+	mutable vector3_type lazy_color;
+
 	// The original 3D vertices
 	vector3_type org_vertex[3];
 
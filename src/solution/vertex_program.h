@@ -66,10 +66,30 @@ namespace graphics {
 	typedef typename VertexProgram<math_types>::graphics_state_type  graphics_state_type;
 	typedef typename math_types::vector3_type                        vector3_type;
 	typedef typename math_types::vector4_type                        vector4_type;
+	typedef typename math_types::matrix3x3_type                      matrix3x3_type;
 	typedef typename math_types::matrix4x4_type                      matrix4x4_type;
 	typedef typename math_types::real_type                           real_type;
 
     public:
+	MyTransformVertexProgram() : m_model_projection(Identity())
+	{
+	    for (int i = 1; i <= 3; ++i)
+		this->m_normal_matrix[i][i] = 1;
+	}
+
+	// Keeps the transformations of the batch, so a vertex costs one 4 x 4
+	// transformation of the point and one 3 x 3 transformation of the normal
+	void begin_batch(graphics_state_type const& state,
+			 matrix4x4_type const& model_projection,
+			 matrix4x4_type const& normal_matrix)
+	{
+	    this->m_model_projection = model_projection;
+	    for (int i = 1; i <= 3; ++i) {
+		for (int j = 1; j <= 3; ++j)
+		    this->m_normal_matrix[i][j] = normal_matrix[i][j];
+	    }
+	}
+
 	void run(graphics_state_type const& state,
 		 vector3_type const& in_vertex,
 		 vector3_type const& in_color,
@@ -96,6 +116,25 @@ namespace graphics {
 	    out_color =  gouraudColor(state,in_vertex,out_normal);
 	}
 
+	bool homogeneous() const
+	{
+	    return true;
+	}
+
+	// Like run, but the render pipeline does the division by w after clipping
+	void run_homogeneous(graphics_state_type const& state,
+			     vector3_type const& in_vertex,
+			     vector3_type const& in_normal,
+			     vector3_type const& in_color,
+			     vector4_type& out_vertex,
+			     vector3_type& out_normal,
+			     vector3_type& out_color)
+	{
+	    out_vertex = this->TransformHomPoint(state, in_vertex);
+	    out_normal = this->TransformNormal(state, in_normal);
+	    out_color =  gouraudColor(state,in_vertex,out_normal);
+	}
+
 	vector3_type gouraudColor(graphics_state_type const& state,
 		 vector3_type const& in_position,
 		 vector3_type const& in_normal)
@@ -210,24 +249,8 @@ namespace graphics {
 	vector3_type TransformPoint(graphics_state_type const& state, vector3_type const& point)
 	{
 	    //std::cout << "-->MyTransformVertexProgram::TransformPoint(vector3_type&)" << std::endl;
-	    //std::cout << "   point = (" << point << ")^T" << std::endl;
-
-	    vector4_type hompoint = HomVector(point);
-	    //std::cout << "   hompoint = [" << hompoint << "]^T" << std::endl;
-
-	    matrix4x4_type modeltrans = state.model();
-	    //std::cout << "   state.model() = " << modeltrans << std::endl;
 
-	    hompoint = modeltrans * hompoint;
-	    //std::cout << "   Model * hompoint = " << hompoint << std::endl;
-
-	    matrix4x4_type M = state.projection();
-	    //std::cout << "   projection =" << M << std::endl;
-
-	    hompoint = M * hompoint;
-	    //std::cout << "   Transformed hompoint = [" << hompoint << "]" << std::endl;
-
-	    vector3_type transformed_point = Vector3D(hompoint);
+	    vector3_type transformed_point = Vector3D(this->TransformHomPoint(state, point));
 	    //std::cout << "   Transformed point = [" << transformed_point << "]" << std::endl;
 
 	    //std::cout << "<--MyTransformVertexProgram::TransformPoint(vector3_type&)" << std::endl;
@@ -235,31 +258,16 @@ namespace graphics {
 	    return transformed_point;
 	}
 
-	// Beware this only use the graphics_state.model() to transform the normal
-	vector3_type TransformNormal(graphics_state_type const& state, vector3_type const& normal)
+	// The point in homogeneous screen coordinates, before the division by w
+	vector4_type TransformHomPoint(graphics_state_type const& state, vector3_type const& point)
 	{
-	    //std::cout << "-->MyTransformVertexProgram::TransformNormal(vector3_type&)" << std::endl;
-	    //std::cout << "   normal = (" << normal << ")^T" << std::endl;
-
-	    vector4_type homnormal = HomNormal(normal);
-	    //std::cout << "   homnormal = [" << homnormal << "]^T" << std::endl;
-
-	    matrix4x4_type inv_modeltrans = state.inv_model();
-	    //std::cout << "   state.inv_model() = " << inv_modeltrans << std::endl;
-
-	    matrix4x4_type inv_modeltrans_transpose = inv_modeltrans.T();
-	    //std::cout << "   inv_model.t() = " << inv_modeltrans_transpose << std::endl;
-
-	    homnormal = inv_modeltrans_transpose * homnormal;
-	    //std::cout << "   inv_model_transpose * homnormal = " << homnormal << std::endl;
-
-	    vector3_type transformed_normal = Normal3D(homnormal);
-	    //std::cout << "   Transformed normal = [" << transformed_normal << "]" << std::endl;
-
-
-	    //std::cout << "<--MyTransformVertexProgram::TransformNormal(vector3_type&)" << std::endl;
+	    return this->m_model_projection * HomVector(point);
+	}
 
-	    return transformed_normal;
+	// The normal in world coordinates, by the normal matrix of the batch
+	vector3_type TransformNormal(graphics_state_type const& state, vector3_type const& normal)
+	{
+	    return this->m_normal_matrix * normal;
 	}
 
 	real_type Clamp(real_type const& value)
@@ -270,6 +278,9 @@ namespace graphics {
 
 		return result;
 	}
+
+	matrix4x4_type m_model_projection;   ///< projection() * model() of the batch
+	matrix3x3_type m_normal_matrix;      ///< The upper left 3 x 3 block of the transpose of inv_model()
     };
 
 }// end namespace graphics